@@ -0,0 +1,79 @@
+/*
+ * benchOcr.cpp
+ *
+ *  Micro benchmark of the frame counter OCR: compares getVidFrame() with the
+ *  original per-pixel implementation on synthetic frames, with and without
+ *  compression-like noise.
+ *
+ */
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+
+#include "../frameOcr.hpp"
+#include "synthData.hpp"
+
+using namespace cv;
+using namespace std;
+
+static const int* const patterns[10] = {zero, one, two, three, four, five, six, seven, eight, nine};
+
+// Original implementation, kept as reference
+static int getVidFrameLegacy(Mat &vidFrame) {
+        uint32_t frameNo = 0;
+        for (int i = 0; i < 8; i++) { // per digit
+                uint16_t isNum = 0x3FF;
+                int vecIdx = 0;
+                for (int idx = 0; idx < ocrPitch * ocrHeight; idx++) { // per pixel in digit
+                        if (idx % ocrPitch < ocrWidth) { // ignore the filling strip on the rigth
+                                Scalar col = vidFrame.at<uchar>(idx / ocrPitch + ocrYOffset, (idx % ocrPitch + ocrPitch * i + ocrXOffset) * 3);
+                                for (int d = 0; d < 10; d++) {
+                                        if (col[0] != patterns[d][vecIdx*3]) isNum &= ~(0b1 << d);
+                                }
+                                vecIdx++;
+                        }
+                }
+                for (int d = 1; d < 10; d++) {
+                        if (isNum & (0b1 << d)) frameNo += pow(10,(7-i)) * d;
+                }
+        }
+        return frameNo;
+}
+
+template <typename F>
+static void run(const char* name, vector<Mat>& frames, const vector<uint32_t>& truth, int iterations, F read) {
+        size_t correct = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++) {
+                for (size_t f = 0; f < frames.size(); f++) {
+                        if ((uint32_t)read(frames[f]) == truth[f]) correct++;
+                }
+        }
+        auto t1 = chrono::steady_clock::now();
+        double ns = chrono::duration<double, nano>(t1 - t0).count() / ((double)iterations * frames.size());
+        cout << name << ": " << ns << " ns/frame, " << 100.0 * correct / ((double)iterations * frames.size()) << "% correct" << endl;
+}
+
+int main(int argc, char** argv) {
+        int iterations = argc > 1 ? atoi(argv[1]) : 200;
+        mt19937 rng(42);
+        uniform_int_distribution<uint32_t> val(0, 99999999);
+
+        for (int noise = 0; noise <= 40; noise += 40) {
+                vector<Mat> frames;
+                vector<uint32_t> truth;
+                for (int f = 0; f < 256; f++) {
+                        Mat frame(64, 256, CV_8UC3, Scalar(0, 0, 0));
+                        uint32_t v = val(rng);
+                        draw_frame_counter(frame, v, noise, rng);
+                        frames.push_back(frame);
+                        truth.push_back(v);
+                }
+                cout << "noise +-" << noise << endl;
+                run("  legacy", frames, truth, iterations, [](Mat& m) { return getVidFrameLegacy(m); });
+                run("  packed", frames, truth, iterations, [](Mat& m) { return getVidFrame(m); });
+        }
+        return 0;
+}
@@ -0,0 +1,396 @@
+/*
+ * benchSuite.cpp
+ *
+ *  Reproducible benchmarks of the rendering stages on synthetic data:
+ *  frame counter OCR, interaction loading and lookup, overlay drawing and
+ *  an end-to-end decode / overlay / encode run. Results can be saved as CSV
+ *  and compared against a previous run.
+ *
+ *  The end-to-end run feeds dat frames from memory: the .dat format is
+ *  owned by atrkutil and not generated here.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <climits>
+#include <random>
+#include <functional>
+#include <opencv2/opencv.hpp>
+
+#include "../frameOcr.hpp"
+#include "../interactions.hpp"
+#include "../interactionCache.hpp"
+#include "../overlay.hpp"
+#include "../pipeline.hpp"
+#include "../render.hpp"
+#include "../trajectoryHistory.hpp"
+#include "synthData.hpp"
+
+using namespace cv;
+using namespace std;
+
+const char* params =
+        "{ help h       | | Print usage }"
+        "{ tags         |500| Number of tags detected per frame }"
+        "{ density      |2| Interactions starting per frame }"
+        "{ width        |0| Video width (0: IMAGE_WIDTH) }"
+        "{ height       |0| Video height (0: IMAGE_HEIGHT) }"
+        "{ frames       |500| Number of frames }"
+        "{ threads j    |1| Overlay worker threads of the end-to-end run }"
+        "{ seed         |42| Seed of the synthetic data }"
+        "{ dir          |.| Directory for the generated files }"
+        "{ report       | | Write the results to a CSV file }"
+        "{ baseline     | | CSV report of a previous run to compare with }";
+
+typedef chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point t0) {
+        return chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// name -> value, in insertion order for printing
+struct Results {
+        vector <pair <string, double> > values;
+        vector <string> units;
+
+        void add(const string& name, double value, const string& unit) {
+                values.push_back(make_pair(name, value));
+                units.push_back(unit);
+                cout << "  " << name << ": " << value << " " << unit << endl;
+        }
+};
+
+static map <string, double> read_baseline(const string& filename) {
+        map <string, double> b;
+        ifstream f(filename.c_str());
+        string line;
+        getline(f, line); // header
+        while (getline(f, line)) {
+                size_t c1 = line.find(',');
+                if (c1 == string::npos) continue;
+                size_t c2 = line.find(',', c1 + 1);
+                b[line.substr(0, c1)] = atof(line.substr(c1 + 1, c2 - c1 - 1).c_str());
+        }
+        return b;
+}
+
+int main(int argc, char** argv) {
+        CommandLineParser parser(argc, argv, params);
+        parser.about("Benchmarks of trkVidOL on synthetic tracking data");
+        if (parser.has("help")) {
+                parser.printMessage();
+                return 0;
+        }
+
+        SynthConfig cfg = default_synth_config();
+        cfg.tags = parser.get<int>("tags");
+        cfg.interactionsPerFrame = parser.get<double>("density");
+        if (parser.get<int>("width") > 0) cfg.width = parser.get<int>("width");
+        if (parser.get<int>("height") > 0) cfg.height = parser.get<int>("height");
+        cfg.frames = parser.get<int>("frames");
+        cfg.seed = parser.get<int>("seed");
+        int threads = max(1, parser.get<int>("threads"));
+        string dir = parser.get<String>("dir");
+
+        cout << "synthetic data: " << cfg.tags << " tags, " << cfg.interactionsPerFrame << " interactions/frame, "
+             << cfg.width << "x" << cfg.height << ", " << cfg.frames << " frames" << endl;
+        string vidName = dir + "/bench_synth.avi";
+        string intName = dir + "/bench_synth.txt";
+        if (!write_synth_video(cfg, vidName)) {
+                cerr << "CANNOT_WRITE_FILE " << vidName << endl;
+                return 1;
+        }
+        size_t nInteractions = write_synth_interactions(cfg, intName);
+        vector <framerec> datFrames(cfg.frames);
+        for (int i = 0; i < cfg.frames; i++) {
+                make_dat_frame(cfg, cfg.firstFrame + i, datFrames[i]);
+        }
+
+        Results res;
+
+        // decode and OCR, keeping a few frames in memory for the other benchmarks
+        cout << "ocr" << endl;
+        const size_t keep = 32;
+        vector <Mat> decoded;
+        {
+                VideoCapture cap(vidName);
+                Mat m;
+                size_t n = 0;
+                Clock::time_point t0 = Clock::now();
+                while (cap.read(m)) {
+                        if (decoded.size() < keep) decoded.push_back(m.clone());
+                        n++;
+                }
+                res.add("decode_ms_per_frame", seconds_since(t0) * 1e3 / max((size_t)1, n), "ms");
+
+                size_t correct = 0;
+                const int reps = 20;
+                t0 = Clock::now();
+                for (int r = 0; r < reps; r++) {
+                        for (size_t i = 0; i < decoded.size(); i++) {
+                                if (getVidFrame(decoded[i]) == cfg.firstFrame + i) correct++;
+                        }
+                }
+                res.add("ocr_us_per_frame", seconds_since(t0) * 1e6 / max((size_t)1, reps * decoded.size()), "us");
+                res.add("ocr_correct_pct", 100.0 * correct / max((size_t)1, reps * decoded.size()), "%");
+        }
+
+        // interactions
+        cout << "interactions (" << nInteractions << ")" << endl;
+        InteractionStore store;
+        {
+                Clock::time_point t0 = Clock::now();
+                read_interaction_file(intName, store, threads);
+                res.add("interaction_parse_ms", seconds_since(t0) * 1e3, "ms");
+                write_interaction_cache(intName, store);
+                InteractionStore mapped;
+                t0 = Clock::now();
+                read_interaction_cache(intName, mapped);
+                res.add("interaction_cache_load_ms", seconds_since(t0) * 1e3, "ms");
+
+                InteractionTimeline timeline(store);
+                size_t active = 0;
+                const int reps = 20;
+                t0 = Clock::now();
+                for (int r = 0; r < reps; r++) {
+                        for (int i = 0; i < cfg.frames; i++) {
+                                timeline.seek(cfg.firstFrame + i);
+                                active += timeline.active().size();
+                        }
+                }
+                res.add("lookup_ns_per_frame", seconds_since(t0) * 1e9 / (reps * cfg.frames), "ns");
+                res.add("active_per_frame", (double)active / (reps * cfg.frames), "");
+
+                // per-pair queries, checked against a scan of the store
+                t0 = Clock::now();
+                store.build_pair_index();
+                res.add("pair_index_build_ms", seconds_since(t0) * 1e3, "ms");
+                const int pairs = 1000;
+                const int n = max(1, min(cfg.tags, tag_count));
+                mt19937 rng(cfg.seed);
+                uniform_int_distribution<int> pick(0, n - 1);
+                vector <pair <int, int> > queries(pairs);
+                for (int q = 0; q < pairs; q++) {
+                        queries[q] = make_pair(tag_list[pick(rng)], tag_list[pick(rng)]);
+                }
+                size_t found = 0;
+                t0 = Clock::now();
+                for (int q = 0; q < pairs; q++) {
+                        pair <const uint32_t*, const uint32_t*> r = store.pair_range(queries[q].first, queries[q].second);
+                        found += r.second - r.first;
+                }
+                res.add("pair_lookup_ns", seconds_since(t0) * 1e9 / pairs, "ns");
+                size_t scanned = 0;
+                for (int q = 0; q < pairs; q++) {
+                        for (size_t i = 0; i < store.size(); i++) {
+                                if ((store.tag1[i] == queries[q].first && store.tag2[i] == queries[q].second) ||
+                                    (store.tag1[i] == queries[q].second && store.tag2[i] == queries[q].first)) scanned++;
+                        }
+                }
+                if (found != scanned) {
+                        cerr << "PAIR_INDEX_MISMATCH " << found << " interactions found, " << scanned << " expected" << endl;
+                        return 1;
+                }
+        }
+
+        // overlay
+        int frameOfDeath[1024];
+        for (int i = 0; i < 1024; i++) {
+                frameOfDeath[i] = INT_MAX;
+        }
+        const int tl = 10;
+        size_t depth = 4 * threads;
+        TrajectoryHistory history(tl + depth);
+        LabelCache labels(FONT_HERSHEY_SCRIPT_SIMPLEX, 0.4, 1);
+        AngleTable angles;
+        OverlayContext ctx;
+        ctx.scW = cfg.width / (double)IMAGE_WIDTH;
+        ctx.scH = cfg.height / (double)IMAGE_HEIGHT;
+        ctx.drawScale = 1.0;
+        ctx.queenId = 665;
+        ctx.hil = 5.0;
+        ctx.history = &history;
+        ctx.frameOfDeath = frameOfDeath;
+        ctx.interactions = &store;
+        ctx.showInteractions = true;
+        ctx.labels = &labels;
+        ctx.angles = &angles;
+
+        cout << "overlay" << endl;
+        {
+                InteractionTimeline timeline(store);
+                OverlayLayer layer;
+                const int side = min(400, min(cfg.width, cfg.height));
+                const Rect crop((cfg.width - side) / 2, (cfg.height - side) / 2, side, side);
+                double total = 0.0;
+                double totalLayer = 0.0;
+                double totalCrop = 0.0;
+                for (int i = 0; i < cfg.frames && !decoded.empty(); i++) {
+                        OverlayFrame f;
+                        f.frameNo = cfg.firstFrame + i;
+                        f.histSeq = history.push(datFrames[i]);
+                        f.trailLen = (int)min(history.size(), (uint64_t)(tl - 1));
+                        timeline.seek(f.frameNo);
+                        f.activeInteractions = timeline.active();
+
+                        // same frame drawn directly, through the layer and cropped through the layer
+                        f.vidFrame = decoded[i % decoded.size()].clone();
+                        Clock::time_point t0 = Clock::now();
+                        draw_overlay(ctx, f);
+                        total += seconds_since(t0);
+
+                        f.vidFrame = decoded[i % decoded.size()].clone();
+                        t0 = Clock::now();
+                        draw_overlay(ctx, f, layer, 1.0);
+                        totalLayer += seconds_since(t0);
+
+                        f.vidFrame = decoded[i % decoded.size()].clone();
+                        f.crops.assign(1, crop);
+                        t0 = Clock::now();
+                        draw_overlay(ctx, f, layer, 1.0);
+                        totalCrop += seconds_since(t0);
+                        f.crops.clear();
+                }
+                res.add("overlay_ms_per_frame", total * 1e3 / cfg.frames, "ms");
+                res.add("overlay_layer_ms_per_frame", totalLayer * 1e3 / cfg.frames, "ms");
+                res.add("overlay_crop_ms_per_frame", totalCrop * 1e3 / cfg.frames, "ms");
+        }
+
+        cout << "end to end (" << threads << " threads)" << endl;
+        {
+                TrajectoryHistory e2eHistory(tl + depth);
+                ctx.history = &e2eHistory;
+                InteractionTimeline timeline(store);
+                VideoCapture cap(vidName);
+                VideoWriter out;
+                string outName = dir + "/bench_synth_out.avi";
+                out.open(outName, VideoWriter::fourcc('M', 'J', 'P', 'G'), 2.0, Size(cfg.width, cfg.height), true);
+                int next = 0;
+                auto readStage = [&](OverlayFrame& f) -> bool {
+                        if (next >= cfg.frames || !cap.read(f.vidFrame)) return false;
+                        f.frameNo = getVidFrame(f.vidFrame);
+                        const framerec& d = datFrames[max(0, min((int)f.frameNo - (int)cfg.firstFrame, cfg.frames - 1))];
+                        f.histSeq = e2eHistory.push(d);
+                        f.trailLen = (int)min(e2eHistory.size(), (uint64_t)(tl - 1));
+                        timeline.seek(d.frame);
+                        f.activeInteractions = timeline.active();
+                        next++;
+                        return true;
+                };
+                auto drawStage = [&](OverlayFrame& f) {
+                        draw_overlay(ctx, f);
+                };
+                auto writeStage = [&](OverlayFrame& f) {
+                        out << f.vidFrame;
+                };
+                Clock::time_point t0 = Clock::now();
+                run_ordered_pipeline<OverlayFrame>(threads, depth, readStage, drawStage, writeStage);
+                res.add("end_to_end_fps", next / seconds_since(t0), "frames/s");
+        }
+
+        // the output must not depend on the number of workers: the overlay stage
+        // of render() (direct, sparse layers reused per thread, overlapping
+        // crops) gives the same frames with 1 and N threads
+        const int checkThreads = threads > 1 ? threads : 4;
+        const int checkFrames = min(cfg.frames, (int)keep);
+        cout << "determinism (" << checkFrames << " frames, 1 vs " << checkThreads << " threads)" << endl;
+        bool deterministic = true;
+        {
+                const Size frameSize(cfg.width, cfg.height);
+                const int side = min(400, min(cfg.width, cfg.height));
+                // two overlapping crops, as for ants close together with --focusTags
+                vector <Rect> crops;
+                crops.push_back(Rect((cfg.width - side) / 2, (cfg.height - side) / 2, side, side));
+                crops.push_back(Rect(min(crops[0].x + side / 3, cfg.width - side), min(crops[0].y + side / 3, cfg.height - side), side, side));
+
+                struct Variant {
+                        const char* name;
+                        bool sparse;
+                        double opacity;
+                        bool cropped;
+                };
+                const Variant variants[] = {
+                        {"direct", false, 1.0, false},
+                        {"sparse", true, 0.7, false},
+                        {"crops", true, 1.0, true}
+                };
+
+                // consume(index, frame) is called in frame order with the whole frame or the clips
+                auto render_frames = [&](const Variant& v, int workers, function <void(int, const vector <Mat>&)> consume) {
+                        RenderOptions opts;
+                        opts.sparse = v.sparse;
+                        opts.opacity = v.opacity;
+                        const size_t d = 4 * workers;
+                        TrajectoryHistory h(tl + d);
+                        ctx.history = &h;
+                        InteractionTimeline timeline(store);
+                        int next = 0;
+                        int done = 0;
+                        auto readStage = [&](OverlayFrame& f) -> bool {
+                                if (next >= checkFrames || decoded.empty()) return false;
+                                f.vidFrame = decoded[next % decoded.size()].clone();
+                                f.frameNo = cfg.firstFrame + next;
+                                f.histSeq = h.push(datFrames[next]);
+                                f.trailLen = (int)min(h.size(), (uint64_t)(tl - 1));
+                                timeline.seek(f.frameNo);
+                                f.activeInteractions = timeline.active();
+                                if (v.cropped) f.crops = crops;
+                                next++;
+                                return true;
+                        };
+                        auto drawStage = [&](OverlayFrame& f) {
+                                draw_render_frame(ctx, opts, frameSize, f);
+                        };
+                        auto checkStage = [&](OverlayFrame& f) {
+                                consume(done++, v.cropped ? f.clips : vector <Mat>(1, f.vidFrame));
+                        };
+                        run_ordered_pipeline<OverlayFrame>(workers, d, readStage, drawStage, checkStage);
+                        return done;
+                };
+                for (size_t k = 0; k < sizeof(variants) / sizeof(variants[0]); k++) {
+                        const Variant& v = variants[k];
+                        vector <vector <Mat> > serial;
+                        render_frames(v, 1, [&](int, const vector <Mat>& m) { serial.push_back(m); });
+                        int n = render_frames(v, checkThreads, [&](int i, const vector <Mat>& m) {
+                                bool same = i < (int)serial.size() && serial[i].size() == m.size();
+                                for (size_t c = 0; same && c < m.size(); c++) {
+                                        same = norm(serial[i][c], m[c], NORM_INF) == 0;
+                                }
+                                if (!same) {
+                                        cerr << "NONDETERMINISTIC_OUTPUT " << v.name << " frame " << cfg.firstFrame + i << endl;
+                                        deterministic = false;
+                                }
+                        });
+                        if (n != (int)serial.size()) {
+                                cerr << "NONDETERMINISTIC_OUTPUT " << v.name << ": " << serial.size() << " frames with 1 thread, "
+                                     << n << " with " << checkThreads << endl;
+                                deterministic = false;
+                        }
+                }
+                res.add("deterministic", deterministic ? 1 : 0, "");
+        }
+
+        if (parser.has("report")) {
+                ofstream f(parser.get<String>("report").c_str());
+                f << "name,value,unit\n";
+                for (size_t i = 0; i < res.values.size(); i++) {
+                        f << res.values[i].first << "," << res.values[i].second << "," << res.units[i] << "\n";
+                }
+        }
+        if (parser.has("baseline")) {
+                map <string, double> base = read_baseline(parser.get<String>("baseline"));
+                cout << "compared with " << parser.get<String>("baseline") << " (new / baseline)" << endl;
+                for (size_t i = 0; i < res.values.size(); i++) {
+                        map <string, double>::const_iterator it = base.find(res.values[i].first);
+                        if (it != base.end() && it->second != 0.0) {
+                                cout << "  " << res.values[i].first << ": " << res.values[i].second / it->second << endl;
+                        }
+                }
+        }
+        return deterministic ? 0 : 1;
+}
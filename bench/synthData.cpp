@@ -0,0 +1,145 @@
+/*
+ * synthData.cpp
+ *
+ *  Synthetic tracking data for the benchmarks, see synthData.hpp.
+ *
+ */
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+#include "synthData.hpp"
+#include "../frameOcr.hpp"
+
+using namespace cv;
+using namespace std;
+
+static const int* const patterns[10] = {zero, one, two, three, four, five, six, seven, eight, nine};
+
+SynthConfig default_synth_config() {
+        SynthConfig cfg;
+        cfg.tags = 500;
+        cfg.interactionsPerFrame = 2.0;
+        cfg.width = IMAGE_WIDTH;
+        cfg.height = IMAGE_HEIGHT;
+        cfg.frames = 500;
+        cfg.firstFrame = 1000;
+        cfg.seed = 42;
+        return cfg;
+}
+
+void draw_frame_counter(Mat& frame, uint32_t value, int noise, mt19937& rng) {
+        uniform_int_distribution<int> dist(-noise, noise);
+        for (int i = ocrDigits - 1; i >= 0; i--) {
+                const int* p = patterns[value % 10];
+                value /= 10;
+                for (int r = 0; r < ocrHeight; r++) {
+                        uchar* row = frame.ptr<uchar>(r + ocrYOffset) + (ocrXOffset + i * ocrPitch) * 3;
+                        for (int b = 0; b < ocrWidth * 3; b++) {
+                                int v = p[r * ocrWidth * 3 + b] + (noise > 0 ? dist(rng) : 0);
+                                row[b] = (uchar)min(255, max(0, v));
+                        }
+                }
+        }
+}
+
+// parameters of the closed path of a tag
+struct TagPath {
+        double cx, cy, rx, ry, w1, w2, phase;
+};
+
+static TagPath tag_path(const SynthConfig& cfg, int tag) {
+        mt19937 rng(cfg.seed * 7919u + tag);
+        uniform_real_distribution<double> u(0.0, 1.0);
+        TagPath p;
+        p.cx = IMAGE_WIDTH * (0.2 + 0.6 * u(rng));
+        p.cy = IMAGE_HEIGHT * (0.2 + 0.6 * u(rng));
+        p.rx = IMAGE_WIDTH * 0.15 * u(rng);
+        p.ry = IMAGE_HEIGHT * 0.15 * u(rng);
+        p.w1 = 0.002 + 0.01 * u(rng);
+        p.w2 = 0.002 + 0.01 * u(rng);
+        p.phase = 2 * M_PI * u(rng);
+        return p;
+}
+
+void make_dat_frame(const SynthConfig& cfg, uint32_t frameNo, framerec& f) {
+        memset(&f, 0, sizeof(f));
+        f.frame = frameNo;
+        int n = min(cfg.tags, tag_count);
+        for (int tag = 0; tag < tag_count; tag++) {
+                if (tag >= n) {
+                        f.tags[tag].x = -1;
+                        f.tags[tag].y = -1;
+                        f.tags[tag].a = 0;
+                        continue;
+                }
+                TagPath p = tag_path(cfg, tag);
+                double t = frameNo;
+                double x = p.cx + p.rx * sin(p.w1 * t + p.phase);
+                double y = p.cy + p.ry * cos(p.w2 * t + p.phase);
+                double dx = p.rx * p.w1 * cos(p.w1 * t + p.phase);
+                double dy = -p.ry * p.w2 * sin(p.w2 * t + p.phase);
+                // heading in centidegrees, -18000..17999 fits the int16_t of tagrec
+                int a = (int)(atan2(dy, dx) * 180.0 / M_PI * 100.0);
+                if (a >= 18000) a -= 36000;
+                f.tags[tag].x = (int16_t)x;
+                f.tags[tag].y = (int16_t)y;
+                f.tags[tag].a = (int16_t)a;
+        }
+}
+
+void make_video_frame(const SynthConfig& cfg, uint32_t frameNo, Mat& frame) {
+        frame.create(cfg.height, cfg.width, CV_8UC3);
+        for (int r = 0; r < frame.rows; r++) {
+                uchar* row = frame.ptr<uchar>(r);
+                for (int c = 0; c < frame.cols * 3; c++) {
+                        row[c] = (uchar)(((r >> 4) ^ (c >> 6) ^ (frameNo >> 3)) & 1 ? 96 : 64);
+                }
+        }
+        mt19937 rng(frameNo);
+        draw_frame_counter(frame, frameNo, 0, rng);
+}
+
+bool write_synth_video(const SynthConfig& cfg, const string& filename) {
+        VideoWriter out;
+        out.open(filename, VideoWriter::fourcc('M', 'J', 'P', 'G'), 2.0, Size(cfg.width, cfg.height), true);
+        if (!out.isOpened()) return false;
+        Mat frame;
+        for (int i = 0; i < cfg.frames; i++) {
+                make_video_frame(cfg, cfg.firstFrame + i, frame);
+                out << frame;
+        }
+        return true;
+}
+
+size_t write_synth_interactions(const SynthConfig& cfg, const string& filename) {
+        ofstream f(filename.c_str());
+        if (!f.is_open()) return 0;
+        f << "tag1,tag2,frame_start,frame_stop,time_start,time_stop,box,x1,y1,a1,x2,y2,a2,direction,det\n";
+        mt19937 rng(cfg.seed);
+        poisson_distribution<int> starts(cfg.interactionsPerFrame);
+        int n = min(cfg.tags, tag_count);
+        uniform_int_distribution<int> pick(0, max(0, n - 1));
+        uniform_int_distribution<int> duration(1, 50);
+        framerec rec;
+        size_t count = 0;
+        for (int i = 0; i < cfg.frames && n > 1; i++) {
+                uint32_t frameNo = cfg.firstFrame + i;
+                int k = starts(rng);
+                if (k == 0) continue;
+                make_dat_frame(cfg, frameNo, rec);
+                for (int j = 0; j < k; j++) {
+                        int t1 = pick(rng);
+                        int t2 = pick(rng);
+                        if (t1 == t2) continue;
+                        uint32_t stop = frameNo + duration(rng);
+                        f << tag_list[t1] << "," << tag_list[t2] << "," << frameNo << "," << stop << ","
+                          << frameNo / 2.0 << "," << stop / 2.0 << ",1,"
+                          << rec.tags[t1].x << "," << rec.tags[t1].y << "," << rec.tags[t1].a << ","
+                          << rec.tags[t2].x << "," << rec.tags[t2].y << "," << rec.tags[t2].a << ",3,1\n";
+                        count++;
+                }
+        }
+        return count;
+}
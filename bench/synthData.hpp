@@ -0,0 +1,60 @@
+/*
+ * synthData.hpp
+ *
+ *  Synthetic tracking data for the benchmarks: videos with the burned-in
+ *  frame counter, dat frames and interaction lists, all derived from a
+ *  seed so that runs are reproducible.
+ *
+ */
+
+#ifndef SYNTH_DATA_HPP
+#define SYNTH_DATA_HPP
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include "anttrackingUNIL/datfile.h"
+
+struct SynthConfig {
+        int tags;                   // number of tags detected per frame (<= tag_count)
+        double interactionsPerFrame; // interactions starting per frame
+        int width;                  // video resolution
+        int height;
+        int frames;                 // number of frames
+        uint32_t firstFrame;        // number printed in the first frame
+        unsigned seed;
+};
+
+SynthConfig default_synth_config();
+
+/** void draw_frame_counter(cv::Mat& frame, uint32_t value, int noise, std::mt19937& rng)
+ * \brief Paints the frame counter with the glyphs of numPatterns.hpp at
+ *        xOffset/yOffset, optionally adding +-noise to every byte
+ */
+void draw_frame_counter(cv::Mat& frame, uint32_t value, int noise, std::mt19937& rng);
+
+/** void make_dat_frame(const SynthConfig& cfg, uint32_t frameNo, framerec& f)
+ * \brief Fills f with the positions of the first cfg.tags tags at frameNo.
+ *        Tags move on smooth closed paths, so any frame can be generated directly.
+ */
+void make_dat_frame(const SynthConfig& cfg, uint32_t frameNo, framerec& f);
+
+/** void make_video_frame(const SynthConfig& cfg, uint32_t frameNo, cv::Mat& frame)
+ * \brief Background texture with the frame counter of frameNo
+ */
+void make_video_frame(const SynthConfig& cfg, uint32_t frameNo, cv::Mat& frame);
+
+/** bool write_synth_video(const SynthConfig& cfg, const std::string& filename)
+ * \brief Writes cfg.frames frames (MJPG) starting at cfg.firstFrame
+ */
+bool write_synth_video(const SynthConfig& cfg, const std::string& filename);
+
+/** size_t write_synth_interactions(const SynthConfig& cfg, const std::string& filename)
+ * \brief Writes an interaction list in the format read by read_interaction_file()
+ * \return Number of interactions written
+ */
+size_t write_synth_interactions(const SynthConfig& cfg, const std::string& filename);
+
+#endif // SYNTH_DATA_HPP
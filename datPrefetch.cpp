@@ -0,0 +1,93 @@
+/*
+ * datPrefetch.cpp
+ *
+ *  Dat file read-ahead, see datPrefetch.hpp.
+ *
+ */
+
+#include "datPrefetch.hpp"
+
+using namespace std;
+
+DatPrefetcher::DatPrefetcher(DatFile& fdat, int depth) :
+        fdat(fdat), ring(depth > 0 ? depth : 1), head(0), tail(0), eof(false), stop(false),
+        seekPending(false), seekTarget(0), generation(0), seekCount(0) {
+        worker = thread(&DatPrefetcher::run, this);
+}
+
+DatPrefetcher::~DatPrefetcher() {
+        {
+                lock_guard <mutex> lock(mtx);
+                stop = true;
+        }
+        freed.notify_all();
+        worker.join();
+}
+
+void DatPrefetcher::run() {
+        unique_lock <mutex> lock(mtx);
+        while (!stop) {
+                if (seekPending) {
+                        const uint32_t target = seekTarget;
+                        seekPending = false;
+                        lock.unlock();
+                        fdat.go_to_frame(target);
+                        lock.lock();
+                        continue;
+                }
+                if (eof || tail - head >= ring.size()) {
+                        freed.wait(lock);
+                        continue;
+                }
+
+                // the slot is not visible to the consumer until tail moves
+                const uint64_t gen = generation;
+                framerec& rec = ring[tail % ring.size()];
+                lock.unlock();
+                bool ok;
+                try {
+                        ok = fdat.read_frame(rec);
+                } catch (...) {
+                        ok = false;
+                }
+                lock.lock();
+                if (gen != generation) continue; // sought meanwhile, the frame is stale
+                if (ok) {
+                        tail++;
+                } else {
+                        eof = true;
+                }
+                filled.notify_one();
+        }
+}
+
+bool DatPrefetcher::read_frame(framerec& f) {
+        unique_lock <mutex> lock(mtx);
+        filled.wait(lock, [this] { return head < tail || (eof && !seekPending); });
+        if (head == tail) return false;
+        f = ring[head % ring.size()];
+        head++;
+        freed.notify_one();
+        return true;
+}
+
+void DatPrefetcher::go_to_frame(uint32_t frame) {
+        {
+                lock_guard <mutex> lock(mtx);
+                for (uint64_t i = head; i < tail; i++) {
+                        if (ring[i % ring.size()].frame == frame) {
+                                head = i;
+                                freed.notify_one();
+                                return;
+                        }
+                }
+                generation++;
+                seekCount++;
+                seekPending = true;
+                seekTarget = frame;
+                head = 0;
+                tail = 0;
+                eof = false;
+        }
+        freed.notify_one();
+}
@@ -0,0 +1,74 @@
+/*
+ * datPrefetch.hpp
+ *
+ *  Read-ahead of the dat file on a background thread, so that the
+ *  rendering loop does not wait on disk (or NFS) for every frame.
+ *
+ */
+
+#ifndef DAT_PREFETCH_HPP
+#define DAT_PREFETCH_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "anttrackingUNIL/datfile.h"
+
+/** class DatPrefetcher
+ * \brief Reads the frames following the current position of a DatFile into
+ *        a ring on its own thread. It has the read_frame() / go_to_frame()
+ *        interface of DatFile; the DatFile must not be used directly while
+ *        the prefetcher exists.
+ */
+class DatPrefetcher {
+public:
+        /** DatPrefetcher(DatFile& fdat, int depth = 128)
+         * \param fdat Open dat file, read from its current position
+         * \param depth Number of frames read ahead
+         */
+        DatPrefetcher(DatFile& fdat, int depth = 128);
+        ~DatPrefetcher();
+
+        /** bool read_frame(framerec& f)
+         * \brief Next frame, waits only if the reader thread has not read it yet
+         * \return false at the end of the file
+         */
+        bool read_frame(framerec& f);
+
+        /** void go_to_frame(uint32_t frame)
+         * \brief Repositions the reading on frame. A frame already read ahead
+         *        is reached by skipping the frames before it, otherwise the
+         *        read-ahead is dropped and the reader thread seeks the file.
+         */
+        void go_to_frame(uint32_t frame);
+
+        // Number of real seeks of the file
+        uint64_t seeks() const { return seekCount; }
+
+private:
+        DatPrefetcher(const DatPrefetcher&);
+        DatPrefetcher& operator=(const DatPrefetcher&);
+
+        void run();
+
+        DatFile& fdat;
+        std::vector <framerec> ring;
+        uint64_t head;          // next frame handed out
+        uint64_t tail;          // frames read into the ring
+        bool eof;
+        bool stop;
+        bool seekPending;
+        uint32_t seekTarget;
+        uint64_t generation;    // incremented by each seek, reads of an older generation are dropped
+        uint64_t seekCount;
+
+        std::mutex mtx;
+        std::condition_variable filled;     // frame read, end of file reached
+        std::condition_variable freed;      // slot freed, seek requested, stop
+        std::thread worker;
+};
+
+#endif // DAT_PREFETCH_HPP
@@ -0,0 +1,123 @@
+/*
+ * frameIndex.cpp
+ *
+ *  Video frame index sidecar, see frameIndex.hpp.
+ *
+ *  Layout (native byte order):
+ *      IndexHeader
+ *      uint32_t frame number of each position of the video
+ *
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+
+#include "frameIndex.hpp"
+#include "frameOcr.hpp"
+
+using namespace cv;
+using namespace std;
+
+static const char indexMagic[8] = {'T', 'R', 'K', 'V', 'I', 'D', 'I', 'X'};
+static const uint32_t byteOrderMark = 0x01020304;
+
+struct IndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t sourceSize;
+        int64_t sourceMtimeSec;
+        int64_t sourceMtimeNsec;
+        uint64_t count;            // number of frames
+};
+
+string frame_index_path(const string& video) {
+        return video + ".trkidx";
+}
+
+bool build_frame_index(const string& video, vector <uint32_t>& frameNos) {
+        VideoCapture capture(video);
+        if (!capture.isOpened()) return false;
+        frameNos.clear();
+        Mat m;
+        while (capture.read(m)) {
+                OcrResult ocr;
+                uint32_t frameNo = getVidFrame(m, ocr);
+                if (!ocr.confident && !frameNos.empty()) {
+                        frameNo = frameNos.back() + 1;
+                }
+                frameNos.push_back(frameNo);
+                if (frameNos.size() % 1000 == 0) cout << " ." << flush;
+        }
+        cout << endl;
+        return true;
+}
+
+bool read_frame_index(const string& video, vector <uint32_t>& frameNos) {
+        struct stat st, sidecar;
+        if (stat(video.c_str(), &st) != 0 || stat(frame_index_path(video).c_str(), &sidecar) != 0) return false;
+        FILE* in = fopen(frame_index_path(video).c_str(), "rb");
+        if (!in) return false;
+
+        IndexHeader h;
+        bool ok = fread(&h, sizeof(h), 1, in) == 1;
+        ok = ok && memcmp(h.magic, indexMagic, sizeof(indexMagic)) == 0 && h.version == frameIndexVersion && h.byteOrder == byteOrderMark;
+        ok = ok && h.sourceSize == (uint64_t)st.st_size && h.sourceMtimeSec == (int64_t)st.st_mtim.tv_sec && h.sourceMtimeNsec == (int64_t)st.st_mtim.tv_nsec;
+        ok = ok && h.count == ((uint64_t)sidecar.st_size - sizeof(h)) / sizeof(uint32_t);
+        if (ok) {
+                frameNos.resize(h.count);
+                if (h.count > 0 && fread(&frameNos[0], sizeof(uint32_t), h.count, in) != h.count) {
+                        cerr << "CORRUPT_CACHE " << frame_index_path(video) << endl;
+                        frameNos.clear();
+                        ok = false;
+                }
+        }
+        fclose(in);
+        return ok;
+}
+
+bool write_frame_index(const string& video, const vector <uint32_t>& frameNos) {
+        struct stat st;
+        if (stat(video.c_str(), &st) != 0) return false;
+
+        IndexHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, indexMagic, sizeof(indexMagic));
+        h.version = frameIndexVersion;
+        h.byteOrder = byteOrderMark;
+        h.sourceSize = st.st_size;
+        h.sourceMtimeSec = st.st_mtim.tv_sec;
+        h.sourceMtimeNsec = st.st_mtim.tv_nsec;
+        h.count = frameNos.size();
+
+        string path = frame_index_path(video);
+        // unique per process: concurrent writers each publish a complete file
+        string tmp = path + ".tmp." + to_string(getpid());
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (!out) return false;
+        bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+        ok = ok && (frameNos.empty() || fwrite(&frameNos[0], sizeof(uint32_t), frameNos.size(), out) == frameNos.size());
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+                remove(tmp.c_str());
+                return false;
+        }
+        return true;
+}
+
+bool load_frame_index(const string& video, vector <uint32_t>& frameNos, bool useCache) {
+        if (useCache && read_frame_index(video, frameNos)) {
+                cout << "frame index read from " << frame_index_path(video) << endl;
+                return true;
+        }
+        cout << "building the frame index of " << video << endl;
+        if (!build_frame_index(video, frameNos)) return false;
+        if (useCache && !write_frame_index(video, frameNos)) {
+                cerr << "CANNOT_WRITE_CACHE " << frame_index_path(video) << endl;
+        }
+        return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * frameIndex.hpp
+ *
+ *  Index of a tracking video: the frame number printed in each frame, by
+ *  position in the video. It is built once by decoding the whole video and
+ *  kept in a binary sidecar next to it, with the size and modification
+ *  time of the video it was built from.
+ *
+ */
+
+#ifndef FRAME_INDEX_HPP
+#define FRAME_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const uint32_t frameIndexVersion = 1;
+
+// Path of the sidecar of a video
+std::string frame_index_path(const std::string& video);
+
+/** bool build_frame_index(const std::string& video, std::vector <uint32_t>& frameNos)
+ * \brief Decodes the video and reads the number printed in every frame.
+ *        Unreliable readings are replaced by the previous number + 1.
+ * \return false if the video cannot be opened
+ */
+bool build_frame_index(const std::string& video, std::vector <uint32_t>& frameNos);
+
+/** bool read_frame_index(const std::string& video, std::vector <uint32_t>& frameNos)
+ * \return false if there is no sidecar, or it is stale, of another version or corrupt
+ */
+bool read_frame_index(const std::string& video, std::vector <uint32_t>& frameNos);
+
+/** bool write_frame_index(const std::string& video, const std::vector <uint32_t>& frameNos)
+ * \brief Writes the sidecar of video (atomically, through a temporary file)
+ */
+bool write_frame_index(const std::string& video, const std::vector <uint32_t>& frameNos);
+
+/** bool load_frame_index(const std::string& video, std::vector <uint32_t>& frameNos, bool useCache)
+ * \brief Reads the sidecar of video when it is up to date, otherwise builds
+ *        the index and (re)writes the sidecar
+ * \return false if the index cannot be built
+ */
+bool load_frame_index(const std::string& video, std::vector <uint32_t>& frameNos, bool useCache);
+
+#endif // FRAME_INDEX_HPP
@@ -0,0 +1,110 @@
+/*
+ * frameOcr.cpp
+ *
+ *  Frame counter OCR, see frameOcr.hpp.
+ *
+ */
+
+#include "frameOcr.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+
+// Bytes spanned by one pixel row of the counter
+static const int stripBytes = ocrDigits * ocrPitch * 3;
+// Number of 16 byte blocks covering a strip row
+static const int stripBlocks = (stripBytes + 15) / 16;
+
+static inline int popcount64(uint64_t v) {
+        return __builtin_popcountll(v);
+}
+
+/** static void threshold_row(const uchar* row, int avail, uint16_t* mask)
+ * \brief Thresholds one row of the counter strip at 128, one bit per byte
+ * \param row First byte of the strip in the row
+ * \param avail Number of bytes readable from row
+ * \param mask stripBlocks words receiving the bits
+ */
+static void threshold_row(const uchar* row, int avail, uint16_t* mask) {
+        int b = 0;
+#ifdef __SSE2__
+        // the sign bit of every byte is set exactly for values >= 128
+        for (; b < stripBlocks && (b + 1) * 16 <= avail; b++) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(row + b * 16));
+                mask[b] = (uint16_t)_mm_movemask_epi8(v);
+        }
+#endif
+        for (; b < stripBlocks; b++) {
+                uint16_t m = 0;
+                for (int i = 0; i < 16 && b * 16 + i < stripBytes; i++) {
+                        if (row[b * 16 + i] >= 128) m |= (uint16_t)(1 << i);
+                }
+                mask[b] = m;
+        }
+}
+
+uint32_t getVidFrame(const Mat& vidFrame, OcrResult& res) {
+        res.frameNo = 0;
+        res.maxDistance = ocrWidth * ocrHeight;
+        res.confident = false;
+        if (vidFrame.type() != CV_8UC3 || vidFrame.rows < ocrYOffset + ocrHeight || vidFrame.cols < ocrXOffset + ocrDigits * ocrPitch) {
+                return 0;
+        }
+
+        GlyphSig sig[ocrDigits];
+        for (int i = 0; i < ocrDigits; i++) {
+                sig[i].lo = 0;
+                sig[i].hi = 0;
+        }
+
+        const int avail = (vidFrame.cols - ocrXOffset) * 3;
+        uint16_t mask[stripBlocks];
+        for (int r = 0; r < ocrHeight; r++) {
+                threshold_row(vidFrame.ptr<uchar>(r + ocrYOffset) + ocrXOffset * 3, avail, mask);
+                for (int i = 0; i < ocrDigits; i++) {
+                        for (int c = 0; c < ocrWidth; c++) {
+                                int b = (i * ocrPitch + c) * 3; // blue channel of the pixel
+                                if (mask[b >> 4] & (1 << (b & 15))) {
+                                        int idx = r * ocrWidth + c;
+                                        if (idx < 64) sig[i].lo |= (uint64_t)1 << idx;
+                                        else sig[i].hi |= (uint64_t)1 << (idx - 64);
+                                }
+                        }
+                }
+        }
+
+        uint32_t frameNo = 0;
+        int worst = 0;
+        bool confident = true;
+        for (int i = 0; i < ocrDigits; i++) {
+                int best = 0;
+                int bestDist = ocrWidth * ocrHeight + 1;
+                int secondDist = ocrWidth * ocrHeight + 1;
+                for (int d = 0; d < 10; d++) {
+                        int dist = popcount64(sig[i].lo ^ glyphs[d].lo) + popcount64(sig[i].hi ^ glyphs[d].hi);
+                        if (dist < bestDist) {
+                                secondDist = bestDist;
+                                bestDist = dist;
+                                best = d;
+                        } else if (dist < secondDist) {
+                                secondDist = dist;
+                        }
+                }
+                if (bestDist > ocrMaxDistance || bestDist == secondDist) confident = false;
+                if (bestDist > worst) worst = bestDist;
+                frameNo = frameNo * 10 + best;
+        }
+
+        res.frameNo = frameNo;
+        res.maxDistance = worst;
+        res.confident = confident;
+        return frameNo;
+}
+
+uint32_t getVidFrame(const Mat& vidFrame) {
+        OcrResult res;
+        return getVidFrame(vidFrame, res);
+}
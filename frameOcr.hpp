@@ -0,0 +1,69 @@
+/*
+ * frameOcr.hpp
+ *
+ *  Reads the frame counter burned into the top left corner of the tracking
+ *  video. The digit glyphs of numPatterns.hpp are packed into 70 bit
+ *  signatures at compile time, each digit cell of a frame is thresholded
+ *  into the same layout and matched by Hamming distance.
+ *
+ */
+
+#ifndef FRAME_OCR_HPP
+#define FRAME_OCR_HPP
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+#include "numPatterns.hpp"
+
+// Position and geometry of the frame counter
+const int ocrPitch = 9;    // Horizontal pitch of a digit (glyph plus filling strip)
+const int ocrXOffset = 54;
+const int ocrYOffset = 2;
+const int ocrWidth = 7;
+const int ocrHeight = 10;
+const int ocrDigits = 8;
+
+// Largest number of differing pixels for a digit to be considered readable
+const int ocrMaxDistance = 8;
+
+// 70 bit pixel signature of a digit cell, bit (row * ocrWidth + col)
+struct GlyphSig {
+        uint64_t lo;
+        uint64_t hi;
+};
+
+constexpr GlyphSig pack_glyph(const int* pattern) {
+        GlyphSig s = {0, 0};
+        for (int idx = 0; idx < ocrWidth * ocrHeight; idx++) {
+                if (pattern[idx * 3] > 127) {
+                        if (idx < 64) s.lo |= (uint64_t)1 << idx;
+                        else s.hi |= (uint64_t)1 << (idx - 64);
+                }
+        }
+        return s;
+}
+
+constexpr GlyphSig glyphs[10] = {
+        pack_glyph(zero), pack_glyph(one), pack_glyph(two), pack_glyph(three), pack_glyph(four),
+        pack_glyph(five), pack_glyph(six), pack_glyph(seven), pack_glyph(eight), pack_glyph(nine)
+};
+
+// Outcome of reading the frame counter
+struct OcrResult {
+        uint32_t frameNo;
+        int maxDistance;  // worst best-match distance over all digits
+        bool confident;   // every digit matched within ocrMaxDistance and unambiguously
+};
+
+/** uint32_t getVidFrame(const cv::Mat& vidFrame, OcrResult& res)
+ * \brief Reads the frame number printed in the video frame
+ * \param vidFrame BGR video frame
+ * \param res Filled with the frame number and the confidence of the read
+ * \return The frame number (0 if the frame is too small to hold the counter)
+ */
+uint32_t getVidFrame(const cv::Mat& vidFrame, OcrResult& res);
+
+uint32_t getVidFrame(const cv::Mat& vidFrame);
+
+#endif // FRAME_OCR_HPP
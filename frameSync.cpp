@@ -0,0 +1,120 @@
+/*
+ * frameSync.cpp
+ *
+ *  Video / dat frame synchronisation, see frameSync.hpp.
+ *
+ */
+
+#include <iostream>
+
+#include "frameSync.hpp"
+
+using namespace std;
+
+FrameSync::FrameSync(DatPrefetcher& fdat, StageStats& stats, const string& name, int window, uint32_t maxGap) :
+        fdat(fdat), stats(stats), name(name), maxGap(maxGap), ring(window > 0 ? window : 1), read(0), eof(false), positioned(false),
+        started(false), last(0), hasSuspect(false), suspect(0) {
+        count.gaps = 0;
+        count.duplicates = 0;
+        count.misreads = 0;
+        count.discontinuities = 0;
+        count.seeks = 0;
+}
+
+uint32_t FrameSync::resolve(uint32_t ocrFrame, bool confident) {
+        if (!started) {
+                started = true;
+                last = ocrFrame;
+                return last;
+        }
+        const uint32_t expected = last + 1;
+        if (ocrFrame == expected) {
+                hasSuspect = false;
+                last = ocrFrame;
+                return last;
+        }
+        if (!confident) {
+                cerr << "OCR_MISREAD " << name << ": frame " << expected << " read as " << ocrFrame << endl;
+                count.misreads++;
+                last = expected;
+                return last;
+        }
+        if (ocrFrame == last) {
+                cerr << "DUPLICATE_FRAME " << name << ": " << ocrFrame << endl;
+                count.duplicates++;
+                return last;
+        }
+        if (ocrFrame > expected && ocrFrame - expected <= maxGap) {
+                cerr << "FRAME_GAP " << name << ": " << last << " -> " << ocrFrame << endl;
+                count.gaps++;
+                hasSuspect = false;
+                last = ocrFrame;
+                return last;
+        }
+        if (hasSuspect && ocrFrame == suspect + 1) {
+                // the previous frame was right after all
+                cerr << "DISCONTINUITY " << name << ": " << last - 1 << " -> " << suspect << endl;
+                count.misreads--;
+                count.discontinuities++;
+                hasSuspect = false;
+                last = ocrFrame;
+                return last;
+        }
+        // A single jump is more likely a misread than a cut in the video
+        cerr << "SUSPECT_FRAME_NUMBER " << name << ": " << ocrFrame << " (expected " << expected << ")" << endl;
+        count.misreads++;
+        hasSuspect = true;
+        suspect = ocrFrame;
+        last = expected;
+        return last;
+}
+
+const framerec* FrameSync::read_next() {
+        framerec& rec = ring[read % ring.size()];
+        if (eof || !fdat.read_frame(rec)) {
+                eof = true;
+                return 0;
+        }
+        read++;
+        return &rec;
+}
+
+const framerec* FrameSync::at(uint32_t frame) {
+        const size_t cap = ring.size();
+        const bool first = !positioned;
+        if (first) {
+                // start from the current position of the file if it is close enough
+                positioned = true;
+                read_next();
+        }
+        if (read > 0) {
+                const framerec& newest = ring[(read - 1) % cap];
+                if (frame <= newest.frame) {
+                        // repeated or late frame, look back through the window
+                        const uint64_t kept = read < cap ? read : cap;
+                        for (uint64_t i = 1; i <= kept; i++) {
+                                const framerec& rec = ring[(read - i) % cap];
+                                if (rec.frame == frame) return &rec;
+                                if (rec.frame < frame) return &ring[(read - i + 1) % cap];
+                        }
+                } else if (frame - newest.frame <= maxGap) {
+                        const framerec* rec;
+                        while ((rec = read_next()) && rec->frame < frame) {}
+                        return rec;
+                }
+        }
+        if (!first) {
+                stats.count_resync();
+                count.seeks++;
+        }
+        fdat.go_to_frame(frame);
+        read = 0;
+        eof = false;
+        return read_next();
+}
+
+void FrameSync::print_summary(ostream& out) const {
+        out << "frame sync (" << name << "): " << count.gaps << " gaps, " << count.duplicates << " duplicate frames, "
+            << count.misreads << " misread frame numbers, " << count.discontinuities << " discontinuities, "
+            << count.seeks << " dat seeks" << endl;
+}
@@ -0,0 +1,92 @@
+/*
+ * frameSync.hpp
+ *
+ *  Synchronisation of the video frames with the dat file. The number of
+ *  each video frame is predicted from the previous one and checked against
+ *  the number read in the frame, and dat frames are read sequentially
+ *  through a window of recent frames: the dat file is only repositioned on
+ *  real discontinuities of the video.
+ *
+ */
+
+#ifndef FRAME_SYNC_HPP
+#define FRAME_SYNC_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "anttrackingUNIL/datfile.h"
+
+#include "datPrefetch.hpp"
+#include "stageStats.hpp"
+
+struct SyncCounters {
+        uint64_t gaps;              // video frames dropped, dat read forward
+        uint64_t duplicates;        // video frame repeated
+        uint64_t misreads;          // frame number not trusted, prediction used
+        uint64_t discontinuities;   // confirmed jumps of the video
+        uint64_t seeks;             // repositionings of the dat file
+};
+
+class FrameSync {
+public:
+        /** FrameSync(DatPrefetcher& fdat, StageStats& stats, const std::string& name, int window = 64, uint32_t maxGap = 32)
+         * \param fdat Read-ahead of the dat file, read from its current position
+         * \param stats Receives a resync count per seek
+         * \param name Video named in the log lines, several jobs may log at once
+         * \param window Number of recent dat frames kept for repeated or late requests
+         * \param maxGap Largest forward jump read sequentially instead of seeking
+         */
+        FrameSync(DatPrefetcher& fdat, StageStats& stats, const std::string& name, int window = 64, uint32_t maxGap = 32);
+
+        /** uint32_t resolve(uint32_t ocrFrame, bool confident)
+         * \brief Number of the next video frame. The number read in the frame is
+         *        accepted if it matches the prediction (previous frame + 1), a
+         *        repeat of the previous frame or a small forward gap. Otherwise
+         *        the prediction is used, until the next frame confirms a jump.
+         *        Anomalies are logged to cerr.
+         * \param ocrFrame Number read in the frame
+         * \param confident False if the number is not reliable (see OcrResult)
+         */
+        uint32_t resolve(uint32_t ocrFrame, bool confident);
+
+        /** const framerec* at(uint32_t frame)
+         * \brief Dat frame of a video frame: taken from the window if it was
+         *        read recently, read forward if it is at most maxGap frames
+         *        ahead, sought otherwise.
+         * \return The first dat frame numbered frame or later, null at the end
+         *         of the dat file. Valid until the next call.
+         */
+        const framerec* at(uint32_t frame);
+
+        const SyncCounters& counters() const { return count; }
+
+        void print_summary(std::ostream& out) const;
+
+private:
+        FrameSync(const FrameSync&);
+        FrameSync& operator=(const FrameSync&);
+
+        // Reads the next dat frame into the window
+        const framerec* read_next();
+
+        DatPrefetcher& fdat;
+        StageStats& stats;
+        const std::string name;
+        const uint32_t maxGap;
+
+        std::vector <framerec> ring;
+        uint64_t read;          // dat frames read since the last seek
+        bool eof;
+        bool positioned;        // at() called at least once
+
+        bool started;
+        uint32_t last;          // number of the previous video frame
+        bool hasSuspect;        // a jump was seen on the previous frame
+        uint32_t suspect;
+        SyncCounters count;
+};
+
+#endif // FRAME_SYNC_HPP
@@ -0,0 +1,163 @@
+/*
+ * heatmap.cpp
+ *
+ *  Occupancy and interaction heatmaps, see heatmap.hpp.
+ *
+ */
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+#include "anttrackingUNIL/tags3.h"
+
+#include "heatmap.hpp"
+
+using namespace cv;
+using namespace std;
+
+HeatmapSet::HeatmapSet(int binSize, const vector <int>& tags) :
+        bin(max(1, binSize)), cols((IMAGE_WIDTH + bin - 1) / bin), rows((IMAGE_HEIGHT + bin - 1) / bin),
+        tagSlot(tag_count, -1) {
+        for (size_t k = 0; k < tags.size(); k++) {
+                int idx;
+                if (find_idx(tags[k], idx) && tagSlot[idx] < 0) {
+                        tagSlot[idx] = tagIds.size();
+                        tagIds.push_back(tags[k]);
+                }
+        }
+}
+
+void HeatmapSet::init(Buffer& b) const {
+        b.occupancy.assign(cols * rows, 0);
+        b.tags.assign(tagIds.size(), vector <uint32_t>(cols * rows, 0));
+}
+
+HeatmapSet::Buffer* HeatmapSet::acquire() {
+        lock_guard <mutex> lock(mtx);
+        if (!unused.empty()) {
+                Buffer* b = unused.back();
+                unused.pop_back();
+                return b;
+        }
+        buffers.push_back(unique_ptr <Buffer>(new Buffer));
+        init(*buffers.back());
+        return buffers.back().get();
+}
+
+void HeatmapSet::release(Buffer* b) {
+        lock_guard <mutex> lock(mtx);
+        unused.push_back(b);
+}
+
+size_t HeatmapSet::cell(int x, int y) const {
+        const int cx = min(max(x / bin, 0), cols - 1);
+        const int cy = min(max(y / bin, 0), rows - 1);
+        return (size_t)cy * cols + cx;
+}
+
+void HeatmapSet::add_frame(Buffer& b, const TrajectoryHistory& hist, uint64_t seq) const {
+        const uint16_t* detected = hist.detected_tags(seq);
+        const int n = hist.detected_count(seq);
+        for (int k = 0; k < n; k++) {
+                const int tagNo = detected[k];
+                const size_t c = cell(hist.x(seq, tagNo), hist.y(seq, tagNo));
+                b.occupancy[c]++;
+                if (tagSlot[tagNo] >= 0) b.tags[tagSlot[tagNo]][c]++;
+        }
+}
+
+void HeatmapSet::add_interactions(Buffer& b, const InteractionStore& st, const vector <uint32_t>& active) const {
+        for (size_t k = 0; k < active.size(); k++) {
+                const uint32_t i = active[k];
+                vector <uint32_t>& grid = b.boxes[st.box[i]];
+                if (grid.empty()) grid.assign(cols * rows, 0);
+                grid[cell((st.x1[i] + st.x2[i]) / 2, (st.y1[i] + st.y2[i]) / 2)]++;
+        }
+}
+
+// numpy .npy file of a rows x cols uint32 array
+static bool write_npy(const string& filename, const vector <uint32_t>& grid, int rows, int cols) {
+        ofstream f(filename.c_str(), ios::binary);
+        if (!f.is_open()) return false;
+        const uint16_t probe = 1;
+        const bool little = *(const uint8_t*)&probe == 1;
+        string header = string("{'descr': '") + (little ? "<u4" : ">u4") + "', 'fortran_order': False, 'shape': ("
+                        + to_string(rows) + ", " + to_string(cols) + "), }";
+        // magic (6) + version (2) + length (2) + header, padded to 64 bytes, ends with \n
+        header.append(63 - (10 + header.size()) % 64, ' ');
+        header += '\n';
+        const uint16_t len = header.size();
+        f.write("\x93NUMPY\x01\x00", 8);
+        const char lenBytes[2] = { (char)(len & 0xff), (char)(len >> 8) };
+        f.write(lenBytes, 2);
+        f << header;
+        f.write((const char*)&grid[0], grid.size() * sizeof(uint32_t));
+        return f.good();
+}
+
+// Color image of a grid, log scaled so that sparse cells stay visible
+static bool write_png(const string& filename, const vector <uint32_t>& grid, int rows, int cols) {
+        const uint32_t peak = *max_element(grid.begin(), grid.end());
+        Mat gray(rows, cols, CV_8UC1);
+        const double norm = peak > 0 ? 255.0 / log1p((double)peak) : 0.0;
+        for (int y = 0; y < rows; y++) {
+                uint8_t* row = gray.ptr<uint8_t>(y);
+                for (int x = 0; x < cols; x++) {
+                        row[x] = (uint8_t)lround(log1p((double)grid[(size_t)y * cols + x]) * norm);
+                }
+        }
+        Mat color;
+        applyColorMap(gray, color, COLORMAP_JET);
+        return imwrite(filename, color);
+}
+
+bool HeatmapSet::write(const string& prefix, const string& format, string& error) const {
+        Buffer total;
+        init(total);
+        {
+                lock_guard <mutex> lock(mtx);
+                for (size_t k = 0; k < buffers.size(); k++) {
+                        const Buffer& b = *buffers[k];
+                        for (size_t c = 0; c < total.occupancy.size(); c++) {
+                                total.occupancy[c] += b.occupancy[c];
+                        }
+                        for (size_t t = 0; t < total.tags.size(); t++) {
+                                for (size_t c = 0; c < total.tags[t].size(); c++) {
+                                        total.tags[t][c] += b.tags[t][c];
+                                }
+                        }
+                        for (map <uint16_t, vector <uint32_t> >::const_iterator it = b.boxes.begin(); it != b.boxes.end(); ++it) {
+                                vector <uint32_t>& grid = total.boxes[it->first];
+                                if (grid.empty()) grid.assign(cols * rows, 0);
+                                for (size_t c = 0; c < grid.size(); c++) {
+                                        grid[c] += it->second[c];
+                                }
+                        }
+                }
+        }
+
+        vector <pair <string, const vector <uint32_t>*> > maps;
+        maps.push_back(make_pair(prefix + "_occupancy", &total.occupancy));
+        for (size_t t = 0; t < tagIds.size(); t++) {
+                maps.push_back(make_pair(prefix + "_tag" + to_string(tagIds[t]), &total.tags[t]));
+        }
+        for (map <uint16_t, vector <uint32_t> >::const_iterator it = total.boxes.begin(); it != total.boxes.end(); ++it) {
+                maps.push_back(make_pair(prefix + "_box" + to_string(it->first), &it->second));
+        }
+
+        const bool png = format == "png" || format == "both";
+        const bool npy = format == "npy" || format == "both";
+        for (size_t k = 0; k < maps.size(); k++) {
+                if (png && !write_png(maps[k].first + ".png", *maps[k].second, rows, cols)) {
+                        error = "CANNOT_WRITE_FILE " + maps[k].first + ".png";
+                        return false;
+                }
+                if (npy && !write_npy(maps[k].first + ".npy", *maps[k].second, rows, cols)) {
+                        error = "CANNOT_WRITE_FILE " + maps[k].first + ".npy";
+                        return false;
+                }
+        }
+        return true;
+}
@@ -0,0 +1,96 @@
+/*
+ * heatmap.hpp
+ *
+ *  Spatial summaries accumulated while rendering: occupancy of the colony
+ *  and of selected tags, and locations of the interactions per box. Counts
+ *  are kept in integer grids over the dat coordinates, one set of grids per
+ *  overlay worker, summed when written.
+ *
+ */
+
+#ifndef HEATMAP_HPP
+#define HEATMAP_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "interactions.hpp"
+#include "trajectoryHistory.hpp"
+
+class HeatmapSet {
+public:
+        // Grids of one worker
+        struct Buffer {
+                std::vector <uint32_t> occupancy;                       // all detected tags
+                std::vector <std::vector <uint32_t> > tags;             // per selected tag
+                std::map <uint16_t, std::vector <uint32_t> > boxes;     // interaction locations per box
+        };
+
+        /** HeatmapSet(int binSize, const std::vector <int>& tags)
+         * \param binSize Side of a grid cell in dat pixels
+         * \param tags Tags with an occupancy map of their own
+         */
+        HeatmapSet(int binSize, const std::vector <int>& tags);
+
+        // Buffer for the calling worker, returned by release()
+        Buffer* acquire();
+        void release(Buffer* b);
+
+        /** void add_frame(Buffer& b, const TrajectoryHistory& hist, uint64_t seq) const
+         * \brief Counts the positions of the tags detected in a frame
+         */
+        void add_frame(Buffer& b, const TrajectoryHistory& hist, uint64_t seq) const;
+
+        /** void add_interactions(Buffer& b, const InteractionStore& st, const std::vector <uint32_t>& active) const
+         * \brief Counts the midpoints of the interactions active in a frame, per box
+         */
+        void add_interactions(Buffer& b, const InteractionStore& st, const std::vector <uint32_t>& active) const;
+
+        /** bool write(const std::string& prefix, const std::string& format, std::string& error) const
+         * \brief Sums the buffers of all workers and writes <prefix>_occupancy,
+         *        <prefix>_tag<N> and <prefix>_box<B>
+         * \param format "png" (log scaled color image), "npy" (uint32 array
+         *        readable with numpy.load) or "both"
+         * \return false if a file cannot be written, error tells which
+         */
+        bool write(const std::string& prefix, const std::string& format, std::string& error) const;
+
+private:
+        HeatmapSet(const HeatmapSet&);
+        HeatmapSet& operator=(const HeatmapSet&);
+
+        size_t cell(int x, int y) const;
+        void init(Buffer& b) const;
+
+        int bin;
+        int cols;
+        int rows;
+        std::vector <int> tagIds;       // selected tags
+        std::vector <int> tagSlot;      // index into tag_list -> index into Buffer::tags, -1 if not selected
+
+        mutable std::mutex mtx;
+        std::vector <std::unique_ptr <Buffer> > buffers;
+        std::vector <Buffer*> unused;
+};
+
+// Holds a buffer of a HeatmapSet for the lifetime of the lease
+class HeatmapLease {
+public:
+        explicit HeatmapLease(HeatmapSet& s) : set(s), buf(s.acquire()) {}
+        ~HeatmapLease() { set.release(buf); }
+
+        HeatmapSet::Buffer& operator*() { return *buf; }
+
+private:
+        HeatmapLease(const HeatmapLease&);
+        HeatmapLease& operator=(const HeatmapLease&);
+
+        HeatmapSet& set;
+        HeatmapSet::Buffer* buf;
+};
+
+#endif // HEATMAP_HPP
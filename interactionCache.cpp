@@ -0,0 +1,188 @@
+/*
+ * interactionCache.cpp
+ *
+ *  Binary interaction sidecar, see interactionCache.hpp.
+ *
+ *  Layout (native byte order):
+ *      CacheHeader
+ *      one array per column, each starting at an 8 byte aligned offset
+ *
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "interactionCache.hpp"
+#include "mappedFile.hpp"
+
+using namespace std;
+
+static const char cacheMagic[8] = {'T', 'R', 'K', 'I', 'N', 'T', 'C', 'H'};
+static const uint32_t byteOrderMark = 0x01020304;
+
+enum CacheColumn {
+        COL_FRAME_START, COL_FRAME_STOP, COL_TIME_START, COL_TIME_STOP,
+        COL_TAG1, COL_TAG2, COL_BOX, COL_X1, COL_Y1, COL_A1, COL_X2, COL_Y2, COL_A2,
+        COL_DIRECTION, COL_DET, COL_FRAME_INDEX, COL_COUNT
+};
+
+struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t sourceSize;
+        int64_t sourceMtimeSec;
+        int64_t sourceMtimeNsec;
+        uint64_t count;            // number of interactions
+        uint32_t bucketFrames;     // frames per frameIndex entry
+        uint32_t bucketCount;      // number of frameIndex entries
+        uint64_t offset[COL_COUNT]; // byte offset of each column
+};
+
+static bool source_stat(const string& source, struct stat& st) {
+        return stat(source.c_str(), &st) == 0;
+}
+
+string interaction_cache_path(const string& source) {
+        return source + ".trkcache";
+}
+
+// column layout for count interactions and bucketCount frame index entries
+static size_t layout(uint64_t count, uint32_t bucketCount, uint64_t* offset) {
+        const size_t width[COL_COUNT] = {
+                sizeof(uint32_t), sizeof(uint32_t), sizeof(double), sizeof(double),
+                sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(int16_t),
+                sizeof(uint16_t), sizeof(uint16_t), sizeof(int16_t), sizeof(uint8_t), sizeof(uint8_t), sizeof(uint32_t)
+        };
+        size_t pos = (sizeof(CacheHeader) + 7) & ~(size_t)7;
+        for (int c = 0; c < COL_COUNT; c++) {
+                offset[c] = pos;
+                pos += width[c] * (c == COL_FRAME_INDEX ? bucketCount : count);
+                pos = (pos + 7) & ~(size_t)7;
+        }
+        return pos;
+}
+
+template <typename T>
+static void map_column(Column <T>& col, const char* base, uint64_t offset, size_t n) {
+        col.view((const T*)(base + offset), n);
+}
+
+bool read_interaction_cache(const string& source, InteractionStore& store) {
+        struct stat st;
+        if (!source_stat(source, st)) return false;
+
+        shared_ptr <MappedFile> f = make_shared <MappedFile>();
+        if (!f->open(interaction_cache_path(source), MADV_RANDOM)) return false;
+        if (f->size() < sizeof(CacheHeader)) return false;
+
+        CacheHeader h;
+        memcpy(&h, f->data(), sizeof(h));
+        if (memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) != 0 || h.version != interactionCacheVersion || h.byteOrder != byteOrderMark) {
+                return false;
+        }
+        if (h.sourceSize != (uint64_t)st.st_size || h.sourceMtimeSec != (int64_t)st.st_mtim.tv_sec || h.sourceMtimeNsec != (int64_t)st.st_mtim.tv_nsec) {
+                return false;
+        }
+        if (h.bucketFrames != interactionBucketFrames) return false;
+
+        uint64_t offset[COL_COUNT];
+        size_t total = layout(h.count, h.bucketCount, offset);
+        if (total > f->size() || memcmp(offset, h.offset, sizeof(offset)) != 0) {
+                cerr << "CORRUPT_CACHE " << interaction_cache_path(source) << endl;
+                return false;
+        }
+
+        store.clear();
+        const char* base = f->data();
+        size_t n = h.count;
+        map_column(store.frameStart, base, offset[COL_FRAME_START], n);
+        map_column(store.frameStop, base, offset[COL_FRAME_STOP], n);
+        map_column(store.timeStart, base, offset[COL_TIME_START], n);
+        map_column(store.timeStop, base, offset[COL_TIME_STOP], n);
+        map_column(store.tag1, base, offset[COL_TAG1], n);
+        map_column(store.tag2, base, offset[COL_TAG2], n);
+        map_column(store.box, base, offset[COL_BOX], n);
+        map_column(store.x1, base, offset[COL_X1], n);
+        map_column(store.y1, base, offset[COL_Y1], n);
+        map_column(store.a1, base, offset[COL_A1], n);
+        map_column(store.x2, base, offset[COL_X2], n);
+        map_column(store.y2, base, offset[COL_Y2], n);
+        map_column(store.a2, base, offset[COL_A2], n);
+        map_column(store.direction, base, offset[COL_DIRECTION], n);
+        map_column(store.det, base, offset[COL_DET], n);
+        map_column(store.frameIndex, base, offset[COL_FRAME_INDEX], h.bucketCount);
+        store.mapping = f;
+        return true;
+}
+
+template <typename T>
+static bool write_column(FILE* out, const Column <T>& col, uint64_t offset) {
+        if (fseek(out, offset, SEEK_SET) != 0) return false;
+        return col.size() == 0 || fwrite(col.data(), sizeof(T), col.size(), out) == col.size();
+}
+
+bool write_interaction_cache(const string& source, const InteractionStore& store) {
+        struct stat st;
+        if (!source_stat(source, st)) return false;
+
+        CacheHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, cacheMagic, sizeof(cacheMagic));
+        h.version = interactionCacheVersion;
+        h.byteOrder = byteOrderMark;
+        h.sourceSize = st.st_size;
+        h.sourceMtimeSec = st.st_mtim.tv_sec;
+        h.sourceMtimeNsec = st.st_mtim.tv_nsec;
+        h.count = store.size();
+        h.bucketFrames = interactionBucketFrames;
+        h.bucketCount = store.frameIndex.size();
+        size_t total = layout(h.count, h.bucketCount, h.offset);
+
+        string path = interaction_cache_path(source);
+        // unique per process: concurrent writers each publish a complete file
+        string tmp = path + ".tmp." + to_string(getpid());
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (!out) return false;
+
+        bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+        ok = ok && write_column(out, store.frameStart, h.offset[COL_FRAME_START]);
+        ok = ok && write_column(out, store.frameStop, h.offset[COL_FRAME_STOP]);
+        ok = ok && write_column(out, store.timeStart, h.offset[COL_TIME_START]);
+        ok = ok && write_column(out, store.timeStop, h.offset[COL_TIME_STOP]);
+        ok = ok && write_column(out, store.tag1, h.offset[COL_TAG1]);
+        ok = ok && write_column(out, store.tag2, h.offset[COL_TAG2]);
+        ok = ok && write_column(out, store.box, h.offset[COL_BOX]);
+        ok = ok && write_column(out, store.x1, h.offset[COL_X1]);
+        ok = ok && write_column(out, store.y1, h.offset[COL_Y1]);
+        ok = ok && write_column(out, store.a1, h.offset[COL_A1]);
+        ok = ok && write_column(out, store.x2, h.offset[COL_X2]);
+        ok = ok && write_column(out, store.y2, h.offset[COL_Y2]);
+        ok = ok && write_column(out, store.a2, h.offset[COL_A2]);
+        ok = ok && write_column(out, store.direction, h.offset[COL_DIRECTION]);
+        ok = ok && write_column(out, store.det, h.offset[COL_DET]);
+        ok = ok && write_column(out, store.frameIndex, h.offset[COL_FRAME_INDEX]);
+        // extend to the full layout size so the last column is entirely inside
+        // the file, without touching its data when it already ends there
+        ok = ok && fflush(out) == 0 && ftruncate(fileno(out), total) == 0;
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+                remove(tmp.c_str());
+                return false;
+        }
+        return true;
+}
+
+void load_interactions(const string& source, InteractionStore& store, int threads, bool useCache) {
+        if (useCache && read_interaction_cache(source, store)) {
+                cout << "interactions mapped from " << interaction_cache_path(source) << endl;
+                return;
+        }
+        read_interaction_file(source, store, threads);
+        if (useCache && !write_interaction_cache(source, store)) {
+                cerr << "CANNOT_WRITE_CACHE " << interaction_cache_path(source) << endl;
+        }
+}
@@ -0,0 +1,42 @@
+/*
+ * interactionCache.hpp
+ *
+ *  Binary sidecar of a parsed interaction file. The sidecar holds the
+ *  columns of an InteractionStore (sorted by frame_start) and its frame
+ *  index, and records the size and modification time of the text file it
+ *  was built from. Loading maps it read-only, so only the pages touched by
+ *  the rendered frame range are read from disk.
+ *
+ */
+
+#ifndef INTERACTION_CACHE_HPP
+#define INTERACTION_CACHE_HPP
+
+#include <string>
+
+#include "interactions.hpp"
+
+const uint32_t interactionCacheVersion = 1;
+
+// Path of the sidecar of an interaction file
+std::string interaction_cache_path(const std::string& source);
+
+/** bool read_interaction_cache(const std::string& source, InteractionStore& store)
+ * \brief Maps the sidecar of source into store
+ * \return false if there is no sidecar, or it is stale, of another version or corrupt
+ */
+bool read_interaction_cache(const std::string& source, InteractionStore& store);
+
+/** bool write_interaction_cache(const std::string& source, const InteractionStore& store)
+ * \brief Writes the sidecar of source (atomically, through a temporary file)
+ * \return false if the sidecar could not be written
+ */
+bool write_interaction_cache(const std::string& source, const InteractionStore& store);
+
+/** void load_interactions(const std::string& source, InteractionStore& store, int threads, bool useCache)
+ * \brief Loads an interaction file, from its sidecar when it is up to date,
+ *        otherwise by parsing the text and (re)writing the sidecar
+ */
+void load_interactions(const std::string& source, InteractionStore& store, int threads, bool useCache);
+
+#endif // INTERACTION_CACHE_HPP
@@ -0,0 +1,449 @@
+/*
+ * interactions.cpp
+ *
+ *  Interaction list reading and lookup, see interactions.hpp.
+ *
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <thread>
+#include <charconv>
+#include <algorithm>
+#include <functional>
+
+#include "anttrackingUNIL/tags3.h"
+
+#include "interactions.hpp"
+#include "mappedFile.hpp"
+
+using namespace std;
+
+// lookup table from tag to its index in tag_list (-1 if absent)
+static const vector <int>& tag_index_table() {
+        static const vector <int> table = [] {
+                int maxTag = 0;
+                for (int i = 0; i < tag_count; i++) {
+                        maxTag = max(maxTag, tag_list[i]);
+                }
+                vector <int> t(maxTag + 1, -1);
+                for (int i = 0; i < tag_count; i++) {
+                        if (tag_list[i] >= 0 && t[tag_list[i]] == -1) t[tag_list[i]] = i;
+                }
+                return t;
+        }();
+        return table;
+}
+
+// convert a tag in the corresponding index of the tag_list table
+bool find_idx(const int tag, int& idx){
+        const vector <int>& table = tag_index_table();
+        if (tag < 0 || tag >= (int)table.size() || table[tag] == -1) {
+                return false;
+        }
+        idx = table[tag];
+        return true;
+}
+
+// function to compare elements of vector
+bool cmp(const event& a, const event& b){
+        return a.d.frame_start < b.d.frame_start;
+}
+
+// Cursor over the fields of one comma separated line
+struct LineParser {
+        const char* p;
+        const char* end;
+        const char* error;
+
+        void skip_blanks() {
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+        }
+
+        // consumes the separator in front of every field but the first
+        bool separator(bool first) {
+                skip_blanks();
+                if (first) return true;
+                if (p < end && *p == ',') {
+                        p++;
+                        skip_blanks();
+                        return true;
+                }
+                error = p < end ? "expected ','" : "missing fields";
+                return false;
+        }
+
+        template <typename T>
+        bool integer(T& out, bool first = false) {
+                if (error || !separator(first)) return false;
+                long long v;
+                from_chars_result r = from_chars(p, end, v);
+                if (r.ec != errc() || v < (long long)numeric_limits<T>::min() || v > (long long)numeric_limits<T>::max()) {
+                        error = "invalid integer";
+                        return false;
+                }
+                out = (T)v;
+                p = r.ptr;
+                return true;
+        }
+
+        bool real(double& out) {
+                if (error || !separator(false)) return false;
+                // strtod needs a terminated string, the mapping is not
+                char buf[64];
+                size_t n = 0;
+                while (p + n < end && n < sizeof(buf) - 1 && p[n] != ',' && p[n] != ' ' && p[n] != '\t') {
+                        buf[n] = p[n];
+                        n++;
+                }
+                buf[n] = 0;
+                char* stop;
+                out = strtod(buf, &stop);
+                if (n == 0 || stop != buf + n) {
+                        error = "invalid number";
+                        return false;
+                }
+                p += n;
+                return true;
+        }
+
+        bool finish() {
+                if (error) return false;
+                skip_blanks();
+                if (p != end) {
+                        error = "unexpected trailing characters";
+                        return false;
+                }
+                return true;
+        }
+};
+
+// Interactions and problems found in one chunk of the file
+struct ChunkResult {
+        vector <event> events;
+        vector <pair <size_t, string> > messages; // (line in chunk, message)
+        size_t lines;
+};
+
+/** static void parse_chunk(const char* begin, const char* end, ChunkResult& res)
+ * \brief Parses the complete lines in [begin, end)
+ */
+static void parse_chunk(const char* begin, const char* end, ChunkResult& res) {
+        res.lines = 0;
+        const char* line = begin;
+        while (line < end) {
+                const char* eol = (const char*)memchr(line, '\n', end - line);
+                if (!eol) eol = end;
+                const char* stop = eol;
+                if (stop > line && stop[-1] == '\r') stop--;
+                size_t lineNo = res.lines++;
+
+                LineParser lp;
+                lp.p = line;
+                lp.end = stop;
+                lp.error = 0;
+                lp.skip_blanks();
+                if (lp.p != stop) {
+                        int tag1 = 0, tag2 = 0;
+                        uint8_t direction = 0, det = 0; // stored as uint8_t, larger values are malformed
+                        ::data temp; // not std::data
+                        memset(&temp, 0, sizeof(temp));
+                        lp.integer(tag1, true);
+                        lp.integer(tag2);
+                        lp.integer(temp.frame_start);
+                        lp.integer(temp.frame_stop);
+                        lp.real(temp.time_start);
+                        lp.real(temp.time_stop);
+                        lp.integer(temp.box);
+                        lp.integer(temp.x1);
+                        lp.integer(temp.y1);
+                        lp.integer(temp.a1);
+                        lp.integer(temp.x2);
+                        lp.integer(temp.y2);
+                        lp.integer(temp.a2);
+                        lp.integer(direction);
+                        lp.integer(det);
+                        temp.direction = direction;
+                        temp.det = det;
+
+                        int idx1 (-1);
+                        int idx2 (-1);
+                        if (!lp.finish()) {
+                                res.messages.push_back(make_pair(lineNo, string("MALFORMED_LINE ") + lp.error + " at column " + to_string(lp.p - line + 1)));
+                        } else if (!find_idx(tag1, idx1)) {
+                                res.messages.push_back(make_pair(lineNo, "TAG_NOT_FOUND " + to_string(tag1)));
+                        } else if (!find_idx(tag2, idx2)) {
+                                res.messages.push_back(make_pair(lineNo, "TAG_NOT_FOUND " + to_string(tag2)));
+                        } else if (idx1 != idx2) {
+                                event e;
+                                e.tag1 = tag1;
+                                e.tag2 = tag2;
+                                e.d = temp;
+                                e.s = 0;
+                                res.events.push_back(e);
+                        }
+                }
+                line = eol + 1;
+        }
+}
+
+void read_interaction_file(string filename, InteractionStore& store, int threads){
+        MappedFile f;
+        if (!f.open(filename, MADV_SEQUENTIAL)) {
+                cerr << "CANNOT_OPEN_FILE " << filename << endl;
+                return;
+        }
+        const char* begin = f.data();
+        const char* end = begin + f.size();
+
+        // skip header line
+        const char* body = begin ? (const char*)memchr(begin, '\n', f.size()) : 0;
+        if (!body) return;
+        body++;
+
+        // split at line boundaries, chunks of at least 1 MB
+        const size_t minChunk = 1 << 20;
+        size_t nChunks = max(1, threads);
+        nChunks = max((size_t)1, min(nChunks, (size_t)(end - body) / minChunk));
+        vector <const char*> bounds(1, body);
+        for (size_t c = 1; c < nChunks; c++) {
+                const char* cut = body + (end - body) * c / nChunks;
+                if (cut < bounds.back()) cut = bounds.back();
+                const char* nl = (const char*)memchr(cut, '\n', end - cut);
+                bounds.push_back(nl ? nl + 1 : end);
+        }
+        bounds.push_back(end);
+
+        vector <ChunkResult> chunks(nChunks);
+        if (nChunks == 1) {
+                parse_chunk(bounds[0], bounds[1], chunks[0]);
+        } else {
+                tag_index_table(); // build before sharing between threads
+                vector <thread> pool;
+                for (size_t c = 0; c < nChunks; c++) {
+                        pool.push_back(thread(parse_chunk, bounds[c], bounds[c + 1], ref(chunks[c])));
+                }
+                for (size_t c = 0; c < nChunks; c++) {
+                        pool[c].join();
+                }
+        }
+
+        // merge in file order, line numbers are 1-based and count the header
+        size_t firstLine = 2;
+        for (size_t c = 0; c < nChunks; c++) {
+                for (size_t m = 0; m < chunks[c].messages.size(); m++) {
+                        cerr << filename << ":" << firstLine + chunks[c].messages[m].first << ": " << chunks[c].messages[m].second << endl;
+                }
+                for (size_t e = 0; e < chunks[c].events.size(); e++) {
+                        store.add(chunks[c].events[e]);
+                }
+                firstLine += chunks[c].lines;
+                vector <event>().swap(chunks[c].events);
+        }
+        store.finalize();
+}
+
+void InteractionStore::add(const event& e) {
+        frameStart.push_back(e.d.frame_start);
+        frameStop.push_back(e.d.frame_stop);
+        timeStart.push_back(e.d.time_start);
+        timeStop.push_back(e.d.time_stop);
+        tag1.push_back(e.tag1);
+        tag2.push_back(e.tag2);
+        box.push_back(e.d.box);
+        x1.push_back(e.d.x1);
+        y1.push_back(e.d.y1);
+        a1.push_back(e.d.a1);
+        x2.push_back(e.d.x2);
+        y2.push_back(e.d.y2);
+        a2.push_back(e.d.a2);
+        direction.push_back((uint8_t)e.d.direction);
+        det.push_back((uint8_t)e.d.det);
+}
+
+event InteractionStore::get(size_t i) const {
+        event e;
+        memset(&e, 0, sizeof(e));
+        e.tag1 = tag1[i];
+        e.tag2 = tag2[i];
+        e.d.frame_start = frameStart[i];
+        e.d.frame_stop = frameStop[i];
+        e.d.time_start = timeStart[i];
+        e.d.time_stop = timeStop[i];
+        e.d.box = box[i];
+        e.d.x1 = x1[i];
+        e.d.y1 = y1[i];
+        e.d.a1 = a1[i];
+        e.d.x2 = x2[i];
+        e.d.y2 = y2[i];
+        e.d.a2 = a2[i];
+        e.d.direction = direction[i];
+        e.d.det = det[i];
+        return e;
+}
+
+// Reorders c so that c[i] becomes c[order[i]]
+template <typename T>
+static void permute(Column <T>& c, const vector <uint32_t>& order) {
+        vector <T> tmp(c.size());
+        for (size_t i = 0; i < order.size(); i++) {
+                tmp[i] = c[order[i]];
+        }
+        c.assign(tmp);
+}
+
+void InteractionStore::finalize() {
+        vector <uint32_t> order(size());
+        for (size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+        }
+        const uint32_t* fs = frameStart.data();
+        stable_sort(order.begin(), order.end(), [&fs](uint32_t a, uint32_t b) { return fs[a] < fs[b]; });
+
+        permute(frameStart, order);
+        permute(frameStop, order);
+        permute(timeStart, order);
+        permute(timeStop, order);
+        permute(tag1, order);
+        permute(tag2, order);
+        permute(box, order);
+        permute(x1, order);
+        permute(y1, order);
+        permute(a1, order);
+        permute(x2, order);
+        permute(y2, order);
+        permute(a2, order);
+        permute(direction, order);
+        permute(det, order);
+
+        // suffix minimum over the buckets in which each interaction ends
+        uint32_t lastFrame = 0;
+        for (size_t i = 0; i < size(); i++) {
+                lastFrame = max(lastFrame, frameStop[i]);
+        }
+        vector <uint32_t> idx(lastFrame / interactionBucketFrames + 1, (uint32_t)size());
+        for (size_t i = 0; i < size(); i++) {
+                uint32_t b = frameStop[i] / interactionBucketFrames;
+                idx[b] = min(idx[b], (uint32_t)i);
+        }
+        for (size_t b = idx.size() - 1; b > 0; b--) {
+                idx[b - 1] = min(idx[b - 1], idx[b]);
+        }
+        frameIndex.assign(idx);
+
+        pairOrder.clear();
+        pairRanges.clear();
+}
+
+void InteractionStore::clear() {
+        frameStart.clear();
+        frameStop.clear();
+        timeStart.clear();
+        timeStop.clear();
+        tag1.clear();
+        tag2.clear();
+        box.clear();
+        x1.clear();
+        y1.clear();
+        a1.clear();
+        x2.clear();
+        y2.clear();
+        a2.clear();
+        direction.clear();
+        det.clear();
+        frameIndex.clear();
+        pairOrder.clear();
+        pairRanges.clear();
+        mapping.reset();
+}
+
+size_t InteractionStore::first_candidate(uint32_t frame) const {
+        if (frameIndex.empty()) return 0;
+        size_t b = min((size_t)(frame / interactionBucketFrames), frameIndex.size() - 1);
+        return frameIndex[b];
+}
+
+uint32_t InteractionStore::pair_key(int tagA, int tagB) {
+        if (tagA > tagB) std::swap(tagA, tagB);
+        return ((uint32_t)tagA << 16) | (uint32_t)tagB;
+}
+
+void InteractionStore::build_pair_index() {
+        pairOrder.resize(size());
+        for (size_t i = 0; i < pairOrder.size(); i++) {
+                pairOrder[i] = i;
+        }
+        // stable: entries of a pair stay sorted by frame_start
+        stable_sort(pairOrder.begin(), pairOrder.end(), [this](uint32_t a, uint32_t b) {
+                return pair_key(tag1[a], tag2[a]) < pair_key(tag1[b], tag2[b]);
+        });
+
+        pairRanges.clear();
+        size_t i = 0;
+        while (i < pairOrder.size()) {
+                uint32_t key = pair_key(tag1[pairOrder[i]], tag2[pairOrder[i]]);
+                size_t j = i + 1;
+                while (j < pairOrder.size() && pair_key(tag1[pairOrder[j]], tag2[pairOrder[j]]) == key) {
+                        j++;
+                }
+                pairRanges[key] = make_pair((uint32_t)i, (uint32_t)j);
+                i = j;
+        }
+}
+
+pair <const uint32_t*, const uint32_t*> InteractionStore::pair_range(int tagA, int tagB) const {
+        unordered_map <uint32_t, pair <uint32_t, uint32_t> >::const_iterator it = pairRanges.find(pair_key(tagA, tagB));
+        if (it == pairRanges.end()) {
+                return make_pair((const uint32_t*)0, (const uint32_t*)0);
+        }
+        return make_pair(pairOrder.data() + it->second.first, pairOrder.data() + it->second.second);
+}
+
+size_t InteractionStore::memory_usage() const {
+        size_t bytes = frameStart.owned_bytes() + frameStop.owned_bytes() + timeStart.owned_bytes() + timeStop.owned_bytes();
+        bytes += tag1.owned_bytes() + tag2.owned_bytes() + box.owned_bytes();
+        bytes += x1.owned_bytes() + y1.owned_bytes() + a1.owned_bytes() + x2.owned_bytes() + y2.owned_bytes() + a2.owned_bytes();
+        bytes += direction.owned_bytes() + det.owned_bytes() + frameIndex.owned_bytes();
+        bytes += pairOrder.capacity() * sizeof(uint32_t);
+        bytes += pairRanges.size() * (sizeof(uint32_t) + sizeof(pair <uint32_t, uint32_t>) + 2 * sizeof(void*));
+        return bytes;
+}
+
+InteractionTimeline::InteractionTimeline(const InteractionStore& store) :
+        store(store), next(0), current(0), started(false) {
+}
+
+void InteractionTimeline::seek(uint32_t frame) {
+        if (started && frame < current) {
+                // going backwards, restart the sweep
+                next = 0;
+                act.clear();
+        }
+        started = true;
+        current = frame;
+
+        // everything before the first candidate has ended
+        size_t lo = store.first_candidate(frame);
+        if (lo > next) {
+                next = lo;
+        }
+
+        // interactions starting up to this frame
+        const uint32_t* frameStart = store.frameStart.data();
+        const uint32_t* frameStop = store.frameStop.data();
+        const size_t n = store.size();
+        while (next < n && frameStart[next] <= frame) {
+                act.push_back(next++);
+        }
+
+        // drop interactions that ended before this frame
+        size_t k = 0;
+        for (size_t i = 0; i < act.size(); i++) {
+                if (frameStop[act[i]] >= frame) {
+                        act[k++] = act[i];
+                }
+        }
+        act.resize(k);
+}
@@ -0,0 +1,197 @@
+/*
+ * interactions.hpp
+ *
+ *  Interaction list reading and frame-ordered lookup of the interactions
+ *  active in a given frame.
+ *
+ */
+
+#ifndef INTERACTIONS_HPP
+#define INTERACTIONS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <unordered_map>
+
+class MappedFile;
+
+// structure of an interaction
+struct data {
+        double time_start;
+        double time_stop;
+        uint32_t frame_start;       // frame of interaction
+        uint32_t frame_stop;        // frame of end of interaction (filled only during filtering)
+        uint16_t box;
+        //coor ant 1
+        uint16_t x1;
+        uint16_t y1;
+        int16_t a1;
+        // coor ant 2
+        uint16_t x2;
+        uint16_t y2;
+        int16_t a2;
+        int det;
+        int direction;     // direction of interaction (1: ant1 interacts, 2: ant2 interacts, 3:both ants interact);
+};
+
+// INteraction event
+struct event {
+        uint16_t tag1;
+        uint16_t tag2;
+        data d;
+        char s;       // state of interaction: long, blinking
+};
+
+typedef std::vector <data> interactions;
+typedef std::vector <std::vector <int> > matrice;
+
+// convert a tag in the corresponding index of the tag_list table
+bool find_idx(const int tag, int& idx);
+
+// function to compare elements of vector
+bool cmp(const event& a, const event& b);
+
+/** class Column
+ * \brief Read-only array of one interaction field. It either owns its
+ *        elements or views memory kept alive by its InteractionStore
+ *        (a mapped cache file).
+ */
+template <typename T>
+class Column {
+public:
+        Column() : ptr(0), n(0) {}
+        Column(Column&&) = default;
+        Column& operator=(Column&&) = default;
+
+        void push_back(const T& v) { own.push_back(v); ptr = own.data(); n = own.size(); }
+        void assign(std::vector <T>& v) { own.swap(v); ptr = own.data(); n = own.size(); }
+        void view(const T* p, size_t count) { std::vector <T>().swap(own); ptr = p; n = count; }
+        void clear() { std::vector <T>().swap(own); ptr = 0; n = 0; }
+
+        const T& operator[](size_t i) const { return ptr[i]; }
+        const T* data() const { return ptr; }
+        size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+        size_t owned_bytes() const { return own.capacity() * sizeof(T); }
+
+private:
+        Column(const Column&);
+        Column& operator=(const Column&);
+
+        std::vector <T> own;
+        const T* ptr;
+        size_t n;
+};
+
+// Number of frames covered by one entry of InteractionStore::frameIndex
+const uint32_t interactionBucketFrames = 1024;
+
+/** class InteractionStore
+ * \brief Struct-of-arrays storage of interactions, one entry per interaction,
+ *        sorted by frame_start once finalize() has been called.
+ */
+class InteractionStore {
+public:
+        Column <uint32_t> frameStart;
+        Column <uint32_t> frameStop;
+        Column <double> timeStart;
+        Column <double> timeStop;
+        Column <uint16_t> tag1;
+        Column <uint16_t> tag2;
+        Column <uint16_t> box;
+        Column <uint16_t> x1;
+        Column <uint16_t> y1;
+        Column <int16_t> a1;
+        Column <uint16_t> x2;
+        Column <uint16_t> y2;
+        Column <int16_t> a2;
+        Column <uint8_t> direction;
+        Column <uint8_t> det;
+
+        // frameIndex[b]: first interaction still running at frame b * interactionBucketFrames
+        Column <uint32_t> frameIndex;
+
+        // Mapped cache file the columns may point into
+        std::shared_ptr <MappedFile> mapping;
+
+        size_t size() const { return frameStart.size(); }
+        bool empty() const { return frameStart.empty(); }
+
+        void add(const event& e);
+        event get(size_t i) const;
+
+        // Sorts all entries by frame_start (stable), builds frameIndex and releases spare capacity
+        void finalize();
+
+        void clear();
+
+        /** size_t first_candidate(uint32_t frame) const
+         * \brief Lower bound on the index of the interactions running at frame:
+         *        every interaction before it ended before frame.
+         */
+        size_t first_candidate(uint32_t frame) const;
+
+        /** void build_pair_index()
+         * \brief Builds the map from a pair of tags to its interactions,
+         *        needed by pair_range()
+         */
+        void build_pair_index();
+
+        /** std::pair <const uint32_t*, const uint32_t*> pair_range(int tagA, int tagB) const
+         * \brief Interactions between two tags (in any order), as a range of
+         *        indices sorted by frame_start. Empty if the pair index is not built.
+         */
+        std::pair <const uint32_t*, const uint32_t*> pair_range(int tagA, int tagB) const;
+
+        // Number of heap bytes held by the store (mapped cache pages excluded)
+        size_t memory_usage() const;
+
+private:
+        static uint32_t pair_key(int tagA, int tagB);
+
+        std::vector <uint32_t> pairOrder;   // indices grouped by pair, then by frame_start
+        std::unordered_map <uint32_t, std::pair <uint32_t, uint32_t> > pairRanges;
+};
+
+/** void read_interaction_file(std::string filename, InteractionStore& store, int threads = 1)
+ * \brief Opens input file with list of interactions (expected format is
+ *        tag1,tag2,frame_start,frame_stop,time_start,time_stop,box,x1,y1,a1,x2,y2,a2,direction,det)
+ *        and reads them into the store, sorted by frame_start. The file is
+ *        memory mapped and parsed in parallel chunks. Malformed lines and
+ *        unknown tags are reported with their line number and skipped.
+ * \param filename Name of the input file to read
+ * \param store Interaction store to fill
+ * \param threads Number of parser threads
+ */
+void read_interaction_file(std::string filename, InteractionStore& store, int threads = 1);
+
+/** class InteractionTimeline
+ * \brief Sweeps over a list of interactions sorted by frame_start and keeps
+ *        the set of interactions active in the current frame. Moving forward
+ *        costs O(active + changes); jumps restart the sweep at the frameIndex
+ *        bucket of the target frame.
+ */
+class InteractionTimeline {
+public:
+        explicit InteractionTimeline(const InteractionStore& store);
+
+        /** void seek(uint32_t frame)
+         * \brief Updates the active set to the interactions with frame_start <= frame <= frame_stop
+         */
+        void seek(uint32_t frame);
+
+        // Indices into the store of the interactions active in the current frame
+        const std::vector <uint32_t>& active() const { return act; }
+
+private:
+        const InteractionStore& store;
+        size_t next;        // first event not yet started
+        uint32_t current;
+        bool started;
+        std::vector <uint32_t> act;
+};
+
+#endif // INTERACTIONS_HPP
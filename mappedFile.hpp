@@ -0,0 +1,69 @@
+/*
+ * mappedFile.hpp
+ *
+ *  Read-only memory mapping of a whole file.
+ *
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class MappedFile {
+public:
+        MappedFile() : addr(0), len(0) {}
+        ~MappedFile() { close(); }
+
+        /** bool open(const std::string& filename, int advice = MADV_NORMAL)
+         * \brief Maps the file read-only
+         * \param advice madvise() hint for the whole mapping
+         * \return false if the file cannot be opened or mapped
+         */
+        bool open(const std::string& filename, int advice = MADV_NORMAL) {
+                close();
+                int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0) return false;
+                struct stat st;
+                if (fstat(fd, &st) != 0) {
+                        ::close(fd);
+                        return false;
+                }
+                len = st.st_size;
+                if (len > 0) {
+                        void* p = mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+                        if (p == MAP_FAILED) {
+                                ::close(fd);
+                                len = 0;
+                                return false;
+                        }
+                        addr = (const char*)p;
+                        madvise(p, len, advice);
+                }
+                ::close(fd);
+                return true;
+        }
+
+        void close() {
+                if (addr) munmap((void*)addr, len);
+                addr = 0;
+                len = 0;
+        }
+
+        const char* data() const { return addr; }
+        size_t size() const { return len; }
+
+private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const char* addr;
+        size_t len;
+};
+
+#endif // MAPPED_FILE_HPP
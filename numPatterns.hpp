@@ -1,4 +1,15 @@
-int zero[21*10] = {
+/*
+ * numPatterns.hpp
+ *
+ *  BGR pixel patterns (7x10 pixels, 3 channels) of the digits of the frame
+ *  counter burned into the tracking video.
+ *
+ */
+
+#ifndef NUM_PATTERNS_HPP
+#define NUM_PATTERNS_HPP
+
+constexpr int zero[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -11,7 +22,7 @@ int zero[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0
 };
 
-int one[21*10] = {
+constexpr int one[21*10] = {
         0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,0,0,0,0,0,0,
         0,0,0,0,0,0,255,255,255,255,255,255,255,255,255,0,0,0,0,0,0,
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,0,0,0,
@@ -24,7 +35,7 @@ int one[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
 };
 
-int two[21*10] = {
+constexpr int two[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -37,7 +48,7 @@ int two[21*10] = {
         255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255
 };
 
-int three[21*10] = {
+constexpr int three[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -50,7 +61,7 @@ int three[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0
 };
 
-int four[21*10] = {
+constexpr int four[21*10] = {
         0,0,0,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,0,0,0,
         0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,255,255,255,0,0,0,
         0,0,0,0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
@@ -63,7 +74,7 @@ int four[21*10] = {
         0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,255,255,255,255,255,255
 };
 
-int five[21*10] = {
+constexpr int five[21*10] = {
         255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
@@ -76,7 +87,7 @@ int five[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0
 };
 
-int six[21*10] = {
+constexpr int six[21*10] = {
         0,0,0,0,0,0,255,255,255,255,255,255,255,255,255,0,0,0,0,0,0,
         0,0,0,255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
@@ -89,7 +100,7 @@ int six[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0
 };
 
-int seven[21*10] = {
+constexpr int seven[21*10] = {
         255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -102,7 +113,7 @@ int seven[21*10] = {
         0,0,0,0,0,0,255,255,255,255,255,255,0,0,0,0,0,0,0,0,0
 };
 
-int eight[21*10] = {
+constexpr int eight[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -115,7 +126,7 @@ int eight[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0
 };
 
-int nine[21*10] = {
+constexpr int nine[21*10] = {
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
         255,255,255,255,255,255,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,
@@ -127,3 +138,5 @@ int nine[21*10] = {
         0,0,0,0,0,0,0,0,0,0,0,0,255,255,255,255,255,255,0,0,0,
         0,0,0,255,255,255,255,255,255,255,255,255,255,255,255,0,0,0,0,0,0
 };
+
+#endif // NUM_PATTERNS_HPP
@@ -0,0 +1,246 @@
+/*
+ * overlay.cpp
+ *
+ *  Drawing of the tracking information, see overlay.hpp.
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "anttrackingUNIL/tags3.h"
+
+#include "overlay.hpp"
+
+using namespace cv;
+using namespace std;
+
+LabelCache::LabelCache(int font, double fontScale, int thickness) :
+        labels(tag_count), masks(tag_count), origins(tag_count) {
+        for (int tagNo = 0; tagNo < tag_count; tagNo++) {
+                labels[tagNo] = to_string(tag_list[tagNo]);
+                int baseline = 0;
+                Size sz = getTextSize(labels[tagNo], font, fontScale, thickness, &baseline);
+                // generous margin, some script glyphs reach outside their box
+                int pad = 2 + thickness + sz.height / 2;
+                origins[tagNo] = Point(pad, pad + sz.height);
+                masks[tagNo] = Mat::zeros(sz.height + baseline + 2 * pad, sz.width + 2 * pad, CV_8UC1);
+                putText(masks[tagNo], labels[tagNo], origins[tagNo], font, fontScale, Scalar(255), thickness, LINE_8, false);
+        }
+}
+
+void LabelCache::draw(Mat& img, int tagNo, Point org, const Scalar& color) const {
+        const Mat& mask = masks[tagNo];
+        Rect dst(org.x - origins[tagNo].x, org.y - origins[tagNo].y, mask.cols, mask.rows);
+        Rect vis = dst & Rect(0, 0, img.cols, img.rows);
+        if (vis.empty()) return;
+        Mat roi = img(vis);
+        roi.setTo(color, mask(Rect(vis.x - dst.x, vis.y - dst.y, vis.width, vis.height)));
+}
+
+AngleTable::AngleTable() : cosTable(36000), sinTable(36000) {
+        for (int a = 0; a < 36000; a++) {
+                double rad = (double)a * M_PI / 180.0 / 100.0;
+                cosTable[a] = cos(rad);
+                sinTable[a] = sin(rad);
+        }
+}
+
+OverlayLayer::OverlayLayer(int tileSize) : tile(max(8, tileSize)), cols(0), rows(0) {
+}
+
+void OverlayLayer::reset(Size frameSize) {
+        if (paint.size() == frameSize) return;
+        paint = Mat::zeros(frameSize, CV_8UC4);
+        cols = (frameSize.width + tile - 1) / tile;
+        rows = (frameSize.height + tile - 1) / tile;
+        dirty.assign(cols * rows, 0);
+}
+
+void OverlayLayer::mark(const Rect& r) {
+        Rect vis = r & Rect(0, 0, paint.cols, paint.rows);
+        if (vis.empty()) return;
+        const int tx1 = (vis.x + vis.width - 1) / tile;
+        const int ty1 = (vis.y + vis.height - 1) / tile;
+        for (int ty = vis.y / tile; ty <= ty1; ty++) {
+                for (int tx = vis.x / tile; tx <= tx1; tx++) {
+                        dirty[ty * cols + tx] = 1;
+                }
+        }
+}
+
+void OverlayLayer::composite(Mat& dst, const vector <Rect>& rois, double opacity) {
+        const int op = (int)(max(0.0, min(1.0, opacity)) * 256.0);
+        for (int ty = 0; ty < rows; ty++) {
+                for (int tx = 0; tx < cols; tx++) {
+                        if (!dirty[ty * cols + tx]) continue;
+                        dirty[ty * cols + tx] = 0;
+                        Rect t = Rect(tx * tile, ty * tile, tile, tile) & Rect(0, 0, paint.cols, paint.rows);
+                        // blend each pixel once, even where rois overlap
+                        Rect r;
+                        for (size_t k = 0; k < rois.size(); k++) {
+                                Rect part = t & rois[k];
+                                if (!part.empty()) r = r.empty() ? part : (r | part);
+                        }
+                        for (int y = r.y; y < r.y + r.height; y++) {
+                                const uint8_t* s = paint.ptr<uint8_t>(y) + 4 * r.x;
+                                uint8_t* d = dst.ptr<uint8_t>(y) + 3 * r.x;
+                                for (int x = 0; x < r.width; x++, s += 4, d += 3) {
+                                        const int a = (s[3] * op) >> 8;
+                                        if (a == 0) continue;
+                                        for (int c = 0; c < 3; c++) {
+                                                d[c] = (uint8_t)((s[c] * a + d[c] * (255 - a) + 127) / 255);
+                                        }
+                                }
+                        }
+                        paint(t).setTo(Scalar::all(0));
+                }
+        }
+}
+
+// Colors carry an opaque alpha so that they also draw into an OverlayLayer
+static inline Scalar bgra(double b, double g, double r) {
+        return Scalar(b, g, r, 255);
+}
+
+// Rectangle with corners a and b, grown by margin pixels
+static inline Rect span(Point2d a, Point2d b, int margin) {
+        return Rect(Point((int)min(a.x, b.x) - margin, (int)min(a.y, b.y) - margin),
+                    Point((int)max(a.x, b.x) + margin + 1, (int)max(a.y, b.y) + margin + 1));
+}
+
+// Regions of the frame that are output: the crops or the whole frame
+static vector <Rect> views_of(const OverlayFrame& f) {
+        if (!f.crops.empty()) return f.crops;
+        return vector <Rect>(1, Rect(0, 0, f.vidFrame.cols, f.vidFrame.rows));
+}
+
+static inline bool visible(const Rect& box, const vector <Rect>& views) {
+        for (size_t k = 0; k < views.size(); k++) {
+                if (!(box & views[k]).empty()) return true;
+        }
+        return false;
+}
+
+/** static Rect stamp_frame_number(const OverlayContext& ctx, uint32_t frameNo, Mat& canvas, const Scalar& color)
+ * \brief Prints the frame number in the top left corner of canvas
+ * \return The region drawn on, padded like the LabelCache masks since
+ *         script glyphs reach outside their text box
+ */
+static Rect stamp_frame_number(const OverlayContext& ctx, uint32_t frameNo, Mat& canvas, const Scalar& color) {
+        // string frameNumb = to_string(datFrameNo);
+        string frameNumb = to_string(frameNo);
+        const double numScale = ctx.drawScale;
+        const int numThickness = ctx.scaled(2);
+        int baseline = 0;
+        Size numSize = getTextSize(frameNumb, FONT_HERSHEY_SCRIPT_SIMPLEX, numScale, numThickness, &baseline);
+        Point numOrg(0, ctx.scaled(50));
+        putText(canvas, frameNumb, numOrg, FONT_HERSHEY_SCRIPT_SIMPLEX, numScale, color, numThickness, LINE_8, false);
+        const int pad = 2 + numThickness + numSize.height / 2;
+        return Rect(numOrg.x - pad, numOrg.y - numSize.height - pad, numSize.width + 2 * pad, numSize.height + baseline + 2 * pad);
+}
+
+/** static void draw_annotations(const OverlayContext& ctx, const OverlayFrame& f, const vector <Rect>& views, Mat& canvas, Mark mark)
+ * \brief Draws the overlay of f onto canvas (the frame or a layer), skipping
+ *        the ants and interactions outside the views, and calls mark(Rect)
+ *        with the bounding box of each drawing.
+ */
+template <typename Mark>
+static void draw_annotations(const OverlayContext& ctx, const OverlayFrame& f, const vector <Rect>& views, Mat& canvas, Mark mark) {
+        const TrajectoryHistory& hist = *ctx.history;
+        const uint64_t cur = f.histSeq;
+        const uint32_t datFrameNo = hist.frame(cur);
+        const double hil = ctx.hil * ctx.drawScale;
+        const int radius = ctx.scaled(2);
+        const int thickness = ctx.scaled(2);
+        const double labelOffset = 4.0 * ctx.drawScale;
+
+        // crops get their number once cut, see cut_clips()
+        if (f.crops.empty()) mark(stamp_frame_number(ctx, f.frameNo, canvas, bgra(0,0,255)));
+
+        const uint16_t* detected = hist.detected_tags(cur);
+        const int detectedCount = hist.detected_count(cur);
+        for (int k = 0; k < detectedCount; k++) {
+                const int tagNo = detected[k];
+                const Point2d pos = ctx.to_video(hist.x(cur, tagNo), hist.y(cur, tagNo));
+                const Point labelOrg(pos.x + labelOffset, pos.y + labelOffset);
+
+                // Bounding box of the ant: trajectory, marker, heading and label
+                Rect box = span(pos, pos, (int)hil + radius + thickness) | ctx.labels->bounds(tagNo, labelOrg);
+                for (int i = 1; i < f.trailLen; i++) {
+                        const uint64_t seq = cur - i;
+                        if (hist.present(seq, tagNo)) {
+                                Point2d p = ctx.to_video(hist.x(seq, tagNo), hist.y(seq, tagNo));
+                                box |= span(p, p, 1);
+                        }
+                }
+                if (!visible(box, views)) continue;
+                mark(box);
+
+                // Draw the trajectory first
+                Point2d head;
+                bool hasHead = false;
+                for (int i = 0; i < f.trailLen; i++) {
+                        const uint64_t seq = cur - i;
+                        if (hist.present(seq, tagNo)) {
+                                Point2d tail = head;
+                                head = ctx.to_video(hist.x(seq, tagNo), hist.y(seq, tagNo));
+                                if (hasHead) {
+                                        line(canvas, Point(head.x, head.y), Point(tail.x, tail.y), bgra(255,255,0), 1, LINE_8);
+                                }
+                                hasHead = true;
+                        }
+                }
+
+                // Now draw everything else
+                const Point centre(pos.x, pos.y);
+                if (tag_list[tagNo] == ctx.queenId) {
+                        circle(canvas, centre, radius, bgra(0,255,255), thickness);
+                } else {
+                        if (datFrameNo < ctx.frameOfDeath[tag_list[tagNo]]) {
+                                circle(canvas, centre, radius, bgra(0,0,255), thickness);
+                        } else {
+                                circle(canvas, centre, radius, bgra(255,0,255), thickness);
+                        }
+                }
+                ctx.labels->draw(canvas, tagNo, labelOrg, bgra(0,255,0));
+                const int a = hist.a(cur, tagNo);
+                line(canvas, centre, Point(pos.x + hil * ctx.angles->cos_cdeg(a), pos.y + hil * ctx.angles->sin_cdeg(a)), bgra(255, 0, 0), 1, LINE_8);
+        }
+
+        if (ctx.showInteractions) {
+                const InteractionStore& st = *ctx.interactions;
+                for (size_t k = 0; k < f.activeInteractions.size(); k++) {
+                        uint32_t i = f.activeInteractions[k];
+                        Point2d p1 = ctx.to_video(st.x1[i], st.y1[i]);
+                        Point2d p2 = ctx.to_video(st.x2[i], st.y2[i]);
+                        Rect box = span(p1, p2, 2);
+                        if (!visible(box, views)) continue;
+                        mark(box);
+                        line(canvas, Point(p1.x, p1.y), Point(p2.x, p2.y), bgra(0,215,255), 1, LINE_8);
+                }
+        }
+}
+
+// Copies the crops of f.vidFrame to f.clips and stamps each with the frame number
+static void cut_clips(const OverlayContext& ctx, OverlayFrame& f) {
+        f.clips.resize(f.crops.size());
+        for (size_t k = 0; k < f.crops.size(); k++) {
+                f.clips[k] = f.vidFrame(f.crops[k]).clone();
+                // not on the shared frame: overlapping crops would show each other's number
+                stamp_frame_number(ctx, f.frameNo, f.clips[k], Scalar(0,0,255));
+        }
+}
+
+void draw_overlay(const OverlayContext& ctx, OverlayFrame& f) {
+        draw_annotations(ctx, f, views_of(f), f.vidFrame, [](const Rect&) {});
+        cut_clips(ctx, f);
+}
+
+void draw_overlay(const OverlayContext& ctx, OverlayFrame& f, OverlayLayer& layer, double opacity) {
+        const vector <Rect> views = views_of(f);
+        layer.reset(f.vidFrame.size());
+        draw_annotations(ctx, f, views, layer.canvas(), [&layer](const Rect& r) { layer.mark(r); });
+        layer.composite(f.vidFrame, views, opacity);
+        cut_clips(ctx, f);
+}
@@ -0,0 +1,153 @@
+/*
+ * overlay.hpp
+ *
+ *  Drawing of the tracking information onto a video frame, either directly
+ *  or through a sparse layer composited only where something is drawn.
+ *
+ */
+
+#ifndef OVERLAY_HPP
+#define OVERLAY_HPP
+
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "interactions.hpp"
+#include "trajectoryHistory.hpp"
+
+/** class LabelCache
+ * \brief Tag id labels rendered once into glyph masks, so that drawing a
+ *        label is a masked copy instead of a text rendering
+ */
+class LabelCache {
+public:
+        LabelCache(int font, double fontScale, int thickness);
+
+        /** void draw(cv::Mat& img, int tagNo, cv::Point org, const cv::Scalar& color) const
+         * \brief Draws the label of tag_list[tagNo] like putText() at org would
+         */
+        void draw(cv::Mat& img, int tagNo, cv::Point org, const cv::Scalar& color) const;
+
+        const std::string& text(int tagNo) const { return labels[tagNo]; }
+
+        // Pixels draw() may touch for a label at org
+        cv::Rect bounds(int tagNo, cv::Point org) const {
+                return cv::Rect(org - origins[tagNo], masks[tagNo].size());
+        }
+
+private:
+        std::vector <std::string> labels;
+        std::vector <cv::Mat> masks;
+        std::vector <cv::Point> origins; // text origin inside the mask
+};
+
+/** class AngleTable
+ * \brief cos and sin of the heading of a tag, for every centi-degree
+ */
+class AngleTable {
+public:
+        AngleTable();
+
+        // a: angle in hundredths of a degree
+        float cos_cdeg(int a) const { return cosTable[wrap(a)]; }
+        float sin_cdeg(int a) const { return sinTable[wrap(a)]; }
+
+private:
+        static int wrap(int a) {
+                a %= 36000;
+                return a < 0 ? a + 36000 : a;
+        }
+
+        std::vector <float> cosTable;
+        std::vector <float> sinTable;
+};
+
+/** class OverlayLayer
+ * \brief Transparent BGRA drawing layer split into square tiles. Drawings
+ *        mark the tiles they touch, and only those tiles are blended onto
+ *        the frame and cleared again, so the cost follows the annotated
+ *        area rather than the frame size. Each overlay worker owns one.
+ */
+class OverlayLayer {
+public:
+        explicit OverlayLayer(int tileSize = 64);
+
+        // Resizes (and clears) the layer if the frame size changed
+        void reset(cv::Size frameSize);
+
+        cv::Mat& canvas() { return paint; }
+
+        // Marks the tiles overlapping r as drawn
+        void mark(const cv::Rect& r);
+
+        /** void composite(cv::Mat& dst, const std::vector <cv::Rect>& rois, double opacity)
+         * \brief Blends the drawn tiles inside the rois onto dst and clears
+         *        all drawn tiles. With opacity 1 the result is the same as
+         *        drawing directly on dst.
+         * \param dst BGR frame of the layer size
+         * \param rois Regions of dst that are used, they may overlap
+         * \param opacity Opacity of the layer, 0 to 1
+         */
+        void composite(cv::Mat& dst, const std::vector <cv::Rect>& rois, double opacity);
+
+private:
+        int tile;
+        int cols;
+        int rows;
+        cv::Mat paint;                  // CV_8UC4, alpha 0 where nothing is drawn
+        std::vector <uint8_t> dirty;    // per tile, row major
+};
+
+// Read-only state shared by all overlay workers
+struct OverlayContext {
+        double scW;         // video pixels per dat pixel, horizontally
+        double scH;         // and vertically
+        double drawScale;   // size of marks, text and lines relative to full resolution rendering
+        int queenId;
+        double hil; // Heading indicator length, at full resolution
+        const TrajectoryHistory* history;
+        const int* frameOfDeath;
+        const InteractionStore* interactions;
+        bool showInteractions;
+        const LabelCache* labels;
+        const AngleTable* angles;
+
+        // Position in the video of the dat coordinates (x, y)
+        cv::Point2d to_video(double x, double y) const { return cv::Point2d(x * scW, y * scH); }
+
+        // A full resolution size in pixels, scaled to the output (at least 1)
+        int scaled(int px) const { return std::max(1, (int)std::lround(px * drawScale)); }
+};
+
+// One video frame travelling through the pipeline
+struct OverlayFrame {
+        cv::Mat vidFrame;
+        uint32_t frameNo;
+        uint64_t histSeq;                           // dat frame of this video frame in OverlayContext::history
+        int trailLen;                               // number of history frames in the trajectory
+        std::vector <uint32_t> activeInteractions;  // indices into OverlayContext::interactions
+        std::vector <cv::Rect> crops;               // regions of vidFrame to output, empty for the whole frame
+        std::vector <cv::Mat> clips;                // the crops, filled by draw_overlay()
+};
+
+/** void draw_overlay(const OverlayContext& ctx, OverlayFrame& f)
+ * \brief Draws frame number, trajectories, tags and interactions onto f.vidFrame.
+ *        Only reads ctx and f, so it can run concurrently on different frames.
+ *        If f.crops is set, only the ants and interactions reaching into a
+ *        crop are drawn and the crops are copied to f.clips.
+ * \param ctx Shared overlay settings and interaction table
+ * \param f Frame to draw on
+ */
+void draw_overlay(const OverlayContext& ctx, OverlayFrame& f);
+
+/** void draw_overlay(const OverlayContext& ctx, OverlayFrame& f, OverlayLayer& layer, double opacity)
+ * \brief Same as draw_overlay(ctx, f), but draws into layer and blends it
+ *        onto f.vidFrame with the given opacity
+ * \param layer Layer of the calling worker
+ */
+void draw_overlay(const OverlayContext& ctx, OverlayFrame& f, OverlayLayer& layer, double opacity);
+
+#endif // OVERLAY_HPP
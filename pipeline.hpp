@@ -0,0 +1,287 @@
+/*
+ * pipeline.hpp
+ *
+ *  Bounded queue and ordered multi-threaded pipeline used to overlap
+ *  decoding, drawing and encoding of the tracking video, and the job
+ *  scheduling of batch mode.
+ *
+ */
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <condition_variable>
+
+/** class BoundedQueue
+ * \brief Blocking FIFO of limited capacity shared between pipeline stages.
+ *        push() blocks while the queue is full, pop() blocks while it is empty.
+ *        Once closed, push() fails and pop() drains the remaining items.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+        explicit BoundedQueue(size_t capacity) : cap(capacity > 0 ? capacity : 1), closed(false) {}
+
+        bool push(T item) {
+                std::unique_lock<std::mutex> lock(mtx);
+                notFull.wait(lock, [this] { return closed || items.size() < cap; });
+                if (closed) return false;
+                items.push_back(std::move(item));
+                notEmpty.notify_one();
+                return true;
+        }
+
+        bool pop(T& item) {
+                std::unique_lock<std::mutex> lock(mtx);
+                notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+                if (items.empty()) return false;
+                item = std::move(items.front());
+                items.pop_front();
+                notFull.notify_one();
+                return true;
+        }
+
+        void close() {
+                std::lock_guard<std::mutex> lock(mtx);
+                closed = true;
+                notFull.notify_all();
+                notEmpty.notify_all();
+        }
+
+private:
+        size_t cap;
+        bool closed;
+        std::deque<T> items;
+        std::mutex mtx;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+};
+
+/** void run_ordered_pipeline(int workers, size_t depth, Produce produce, Process process, Consume consume)
+ * \brief Runs produce -> process -> consume over a stream of items.
+ *        produce(T&) is called on a single reader thread until it returns false,
+ *        process(T&) runs on a pool of workers and consume(T&) is called on the
+ *        calling thread strictly in production order. At most depth items are
+ *        in flight at any time. With workers <= 1 all stages run serially on the
+ *        calling thread. The first exception thrown by any stage stops the
+ *        pipeline and is rethrown to the caller.
+ * \param workers Number of process() threads
+ * \param depth Maximum number of items between produce() and consume()
+ */
+template <typename T, typename Produce, typename Process, typename Consume>
+void run_ordered_pipeline(int workers, size_t depth, Produce produce, Process process, Consume consume) {
+        if (workers <= 1) {
+                T item;
+                while (produce(item)) {
+                        process(item);
+                        consume(item);
+                        item = T();
+                }
+                return;
+        }
+        if (depth < (size_t)workers) depth = workers;
+
+        typedef std::pair<uint64_t, T> Slot;
+        BoundedQueue<Slot> todo(depth);
+        BoundedQueue<Slot> done(depth);
+
+        // in-flight accounting keeps the reorder buffer bounded
+        std::mutex flightMtx;
+        std::condition_variable flightCv;
+        size_t inFlight = 0;
+        bool abort = false;
+
+        std::mutex errMtx;
+        std::exception_ptr err;
+        auto fail = [&](std::exception_ptr e) {
+                {
+                        std::lock_guard<std::mutex> lock(errMtx);
+                        if (!err) err = e;
+                }
+                {
+                        std::lock_guard<std::mutex> lock(flightMtx);
+                        abort = true;
+                }
+                flightCv.notify_all();
+                todo.close();
+                done.close();
+        };
+
+        std::thread reader([&] {
+                try {
+                        uint64_t seq = 0;
+                        for (;;) {
+                                {
+                                        std::unique_lock<std::mutex> lock(flightMtx);
+                                        flightCv.wait(lock, [&] { return abort || inFlight < depth; });
+                                        if (abort) break;
+                                        inFlight++;
+                                }
+                                Slot s;
+                                s.first = seq++;
+                                if (!produce(s.second) || !todo.push(std::move(s))) break;
+                        }
+                } catch (...) {
+                        fail(std::current_exception());
+                }
+                todo.close();
+        });
+
+        std::mutex poolMtx;
+        int running = workers;
+        std::vector<std::thread> pool;
+        for (int w = 0; w < workers; w++) {
+                pool.push_back(std::thread([&] {
+                        try {
+                                Slot s;
+                                while (todo.pop(s)) {
+                                        process(s.second);
+                                        if (!done.push(std::move(s))) break;
+                                }
+                        } catch (...) {
+                                fail(std::current_exception());
+                        }
+                        std::lock_guard<std::mutex> lock(poolMtx);
+                        if (--running == 0) done.close();
+                }));
+        }
+
+        try {
+                uint64_t next = 0;
+                std::map<uint64_t, T> pending;
+                Slot s;
+                while (done.pop(s)) {
+                        pending.insert(std::make_pair(s.first, std::move(s.second)));
+                        typename std::map<uint64_t, T>::iterator it;
+                        while ((it = pending.find(next)) != pending.end()) {
+                                consume(it->second);
+                                pending.erase(it);
+                                next++;
+                                {
+                                        std::lock_guard<std::mutex> lock(flightMtx);
+                                        inFlight--;
+                                }
+                                flightCv.notify_one();
+                        }
+                }
+        } catch (...) {
+                fail(std::current_exception());
+        }
+
+        reader.join();
+        for (size_t w = 0; w < pool.size(); w++) {
+                pool[w].join();
+        }
+        if (err) std::rethrow_exception(err);
+}
+
+/** class Semaphore
+ * \brief Counting semaphore, limits how many threads run a section at once
+ */
+class Semaphore {
+public:
+        explicit Semaphore(int count) : count(count) {}
+
+        void acquire() {
+                std::unique_lock<std::mutex> lock(mtx);
+                freed.wait(lock, [this] { return count > 0; });
+                count--;
+        }
+
+        void release() {
+                {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        count++;
+                }
+                freed.notify_one();
+        }
+
+private:
+        int count;
+        std::mutex mtx;
+        std::condition_variable freed;
+};
+
+// Holds a Semaphore (if any) for the lifetime of the guard
+class SemaphoreGuard {
+public:
+        explicit SemaphoreGuard(Semaphore* s) : sem(s) { if (sem) sem->acquire(); }
+        ~SemaphoreGuard() { if (sem) sem->release(); }
+
+private:
+        SemaphoreGuard(const SemaphoreGuard&);
+        SemaphoreGuard& operator=(const SemaphoreGuard&);
+
+        Semaphore* sem;
+};
+
+/** void run_work_stealing(int workers, size_t jobs, Run run)
+ * \brief Runs run(job, worker) for every job in [0, jobs) on a pool of
+ *        workers. Jobs are dealt round-robin into one deque per worker; a
+ *        worker takes from the front of its own deque and, once it is empty,
+ *        steals from the back of the others. run() must not throw.
+ */
+template <typename Run>
+void run_work_stealing(int workers, size_t jobs, Run run) {
+        if (workers < 1) workers = 1;
+        if ((size_t)workers > jobs) workers = jobs;
+        if (workers <= 1) {
+                for (size_t j = 0; j < jobs; j++) {
+                        run(j, 0);
+                }
+                return;
+        }
+
+        struct WorkerQueue {
+                std::mutex mtx;
+                std::deque<size_t> items;
+        };
+        std::vector<WorkerQueue> queues(workers);
+        for (size_t j = 0; j < jobs; j++) {
+                queues[j % workers].items.push_back(j);
+        }
+
+        auto take = [&](int w, size_t& job) -> bool {
+                {
+                        std::lock_guard<std::mutex> lock(queues[w].mtx);
+                        if (!queues[w].items.empty()) {
+                                job = queues[w].items.front();
+                                queues[w].items.pop_front();
+                                return true;
+                        }
+                }
+                for (int k = 1; k < workers; k++) {
+                        WorkerQueue& victim = queues[(w + k) % workers];
+                        std::lock_guard<std::mutex> lock(victim.mtx);
+                        if (!victim.items.empty()) {
+                                job = victim.items.back();
+                                victim.items.pop_back();
+                                return true;
+                        }
+                }
+                return false;
+        };
+
+        std::vector<std::thread> pool;
+        for (int w = 0; w < workers; w++) {
+                pool.push_back(std::thread([&, w] {
+                        size_t job;
+                        while (take(w, job)) {
+                                run(job, w);
+                        }
+                }));
+        }
+        for (size_t w = 0; w < pool.size(); w++) {
+                pool[w].join();
+        }
+}
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,109 @@
+/*
+ * rawVideo.cpp
+ *
+ *  Raw frame stream input and output, see rawVideo.hpp.
+ *
+ */
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rawVideo.hpp"
+
+using namespace cv;
+using namespace std;
+
+// Grows the kernel buffer of a pipe to hold a frame, fewer wakeups per frame
+static void grow_pipe(int fd, size_t bytes) {
+#ifdef F_SETPIPE_SZ
+        if (fcntl(fd, F_GETPIPE_SZ) < (int)bytes) {
+                fcntl(fd, F_SETPIPE_SZ, (int)bytes); // may fail above the system limit, harmless
+        }
+#else
+        (void)fd;
+        (void)bytes;
+#endif
+}
+
+bool RawVideoReader::open(const string& path, Size size) {
+        close();
+        if (size.width <= 0 || size.height <= 0) return false;
+        if (path == "-") {
+                fd = STDIN_FILENO;
+                owned = false;
+        } else {
+                fd = ::open(path.c_str(), O_RDONLY);
+                owned = true;
+                if (fd < 0) return false;
+        }
+        sz = size;
+        partial = false;
+        err = 0;
+        grow_pipe(fd, (size_t)sz.width * sz.height * 3);
+        return true;
+}
+
+bool RawVideoReader::read(Mat& frame) {
+        if (fd < 0) return false;
+        frame = Mat(sz, CV_8UC3);
+        const size_t n = frame.total() * frame.elemSize();
+        char* p = (char*)frame.data;
+        size_t got = 0;
+        while (got < n) {
+                ssize_t r = ::read(fd, p + got, n - got);
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0) err = errno;
+                if (r <= 0) break;
+                got += r;
+        }
+        if (got < n) {
+                partial = got > 0;
+                frame = Mat();
+                return false;
+        }
+        return true;
+}
+
+void RawVideoReader::close() {
+        if (owned && fd >= 0) ::close(fd);
+        fd = -1;
+        owned = false;
+}
+
+bool RawVideoWriter::open(const string& path) {
+        close();
+        if (path == "-") {
+                fd = STDOUT_FILENO;
+                owned = false;
+        } else {
+                fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                owned = true;
+        }
+        return fd >= 0;
+}
+
+bool RawVideoWriter::write(const Mat& frame) {
+        if (fd < 0 || frame.type() != CV_8UC3) return false;
+        const size_t rowBytes = frame.cols * frame.elemSize();
+        // one write for a continuous frame, one per row otherwise
+        const int chunks = frame.isContinuous() ? 1 : frame.rows;
+        const size_t chunkBytes = frame.isContinuous() ? rowBytes * frame.rows : rowBytes;
+        for (int c = 0; c < chunks; c++) {
+                const char* p = (const char*)frame.ptr(c);
+                size_t done = 0;
+                while (done < chunkBytes) {
+                        ssize_t w = ::write(fd, p + done, chunkBytes - done);
+                        if (w < 0 && errno == EINTR) continue;
+                        if (w <= 0) return false;
+                        done += w;
+                }
+        }
+        return true;
+}
+
+void RawVideoWriter::close() {
+        if (owned && fd >= 0) ::close(fd);
+        fd = -1;
+        owned = false;
+}
@@ -0,0 +1,84 @@
+/*
+ * rawVideo.hpp
+ *
+ *  Raw BGR24 frames (ffmpeg -f rawvideo -pix_fmt bgr24) read from or
+ *  written to a file, a FIFO or the standard streams, so that trkVidOL can
+ *  sit between a decoder and an encoder process without temporary files.
+ *
+ */
+
+#ifndef RAW_VIDEO_HPP
+#define RAW_VIDEO_HPP
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+class RawVideoReader {
+public:
+        RawVideoReader() : fd(-1), owned(false), partial(false), err(0) {}
+        ~RawVideoReader() { close(); }
+
+        /** bool open(const std::string& path, cv::Size size)
+         * \brief Opens a stream of size.width x size.height BGR frames
+         * \param path File or FIFO, "-" for the standard input
+         * \return false if the stream cannot be opened
+         */
+        bool open(const std::string& path, cv::Size size);
+
+        /** bool read(cv::Mat& frame)
+         * \brief Reads the next frame into a newly allocated CV_8UC3 image
+         * \return false at the end of the stream or on a read error (see
+         *         truncated() and error())
+         */
+        bool read(cv::Mat& frame);
+
+        // The stream ended in the middle of a frame, which was dropped
+        bool truncated() const { return partial; }
+
+        // errno of the read that failed, 0 if the stream ended normally
+        int error() const { return err; }
+
+        cv::Size size() const { return sz; }
+        void close();
+
+private:
+        RawVideoReader(const RawVideoReader&);
+        RawVideoReader& operator=(const RawVideoReader&);
+
+        int fd;
+        bool owned;     // fd opened by us (not stdin)
+        bool partial;
+        int err;
+        cv::Size sz;
+};
+
+class RawVideoWriter {
+public:
+        RawVideoWriter() : fd(-1), owned(false) {}
+        ~RawVideoWriter() { close(); }
+
+        /** bool open(const std::string& path)
+         * \param path File or FIFO, "-" for the standard output
+         * \return false if the stream cannot be opened
+         */
+        bool open(const std::string& path);
+
+        bool isOpened() const { return fd >= 0; }
+
+        /** bool write(const cv::Mat& frame)
+         * \brief Writes the pixels of a CV_8UC3 frame
+         * \return false if the stream is closed by the reader or fails
+         */
+        bool write(const cv::Mat& frame);
+
+        void close();
+
+private:
+        RawVideoWriter(const RawVideoWriter&);
+        RawVideoWriter& operator=(const RawVideoWriter&);
+
+        int fd;
+        bool owned;
+};
+
+#endif // RAW_VIDEO_HPP
@@ -0,0 +1,554 @@
+/*
+ * render.cpp
+ *
+ *  Rendering of one tracking video, see render.hpp.
+ *
+ */
+
+#include <iostream>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+
+#include "anttrackingUNIL/tags3.h"
+#include "anttrackingUNIL/datfile.h"
+
+#include "render.hpp"
+#include "rawVideo.hpp"
+#include "frameOcr.hpp"
+#include "datPrefetch.hpp"
+#include "frameSync.hpp"
+#include "heatmap.hpp"
+#include "stageStats.hpp"
+#include "trajectoryHistory.hpp"
+
+using namespace cv;
+using namespace std;
+
+SharedData::SharedData() :
+        hasInteractions(false), labels(FONT_HERSHEY_SCRIPT_SIMPLEX, 0.4, 1) {
+        for (int i = 0; i < 1024; i++) {
+                frameOfDeath[i] = INT_MAX;
+        }
+}
+
+void SharedData::load_tags(const string& filename) {
+        TagsFile ftag;
+        char fname_c[filename.size() + 1];
+        strcpy(fname_c, filename.c_str());
+        ftag.read_file(fname_c);
+
+        for (int i = 0; i < tag_count; i++) {
+                if (ftag.get_state(i) && ftag.get_death(i) > 0) {
+                        frameOfDeath[ftag.get_tag(i)] = ftag.get_death(i);
+                }
+        }
+}
+
+RenderOptions::RenderOptions() :
+        rawIn(false), rawFps(25.0), rawOut(false), threads(1), tl(10), queenId(665), show(false), progress(true),
+        hasStartFrame(false), hasEndFrame(false), hasStartTime(false), hasEndTime(false),
+        startFrame(0), endFrame(UINT32_MAX), startTime(0.0), endTime(0.0),
+        scale(1.0), sparse(false), opacity(1.0), followTag(-1), cropSize(400),
+        heatmapFormat("png"), heatmapBin(8), stats(false), encoders(0) {
+}
+
+bool seek_video(VideoCapture& capture, uint32_t firstFrameNo, uint32_t target, Mat& vidFrame, uint32_t& frameNo) {
+        const int maxJumps = 4;
+        const int maxForward = 256; // read forward rather than jump when this close
+        double pos = (double)target - firstFrameNo;
+        double landed = 0;          // position of vidFrame
+        bool confident = false;
+        double safe = -1;           // closest position read confidently at or before the target
+        uint32_t safeNo = 0;
+        auto land = [&](double at) {
+                capture.set(CAP_PROP_POS_FRAMES, at);
+                capture >> vidFrame;
+                if (vidFrame.empty()) return false;
+                landed = at;
+                OcrResult ocr;
+                frameNo = getVidFrame(vidFrame, ocr);
+                confident = ocr.confident;
+                if (confident && frameNo <= target && (safe < 0 || frameNo > safeNo)) {
+                        safe = at;
+                        safeNo = frameNo;
+                }
+                return true;
+        };
+
+        for (int jump = 0; jump < maxJumps; jump++) {
+                if (pos < 0) pos = 0;
+                if (!land(pos)) return false;
+                if (!confident) break;
+                if (frameNo == target) return true;
+                if (frameNo < target && target - frameNo <= (uint32_t)maxForward) break;
+                if (frameNo > target && pos == 0) return true;
+                pos += (double)target - frameNo;
+        }
+
+        // past the target or unreadable: step back by a bounded margin (growing
+        // while still past the target) rather than decoding from the start
+        double margin = 2 * maxForward;
+        int unreadable = 0;
+        while (landed > 0 && (!confident || frameNo > target)) {
+                if (!confident && unreadable++ >= maxJumps) break;
+                double back = max(0.0, landed - margin);
+                if (confident) margin *= 2;
+                if (!land(back)) return false;
+        }
+        if (confident && frameNo > target) return true; // target precedes the first frame
+        if (!confident) {
+                if (landed == 0) {
+                        frameNo = firstFrameNo;
+                } else {
+                        // counter unreadable around the target: read forward from the
+                        // closest position read confidently before it, if any
+                        if (safe < 0 || !land(safe)) return false;
+                        frameNo = safeNo;
+                }
+        }
+        // frames follow each other from here, unreadable numbers are predicted
+        while (frameNo < target) {
+                capture >> vidFrame;
+                if (vidFrame.empty()) return false;
+                OcrResult ocr;
+                uint32_t n = getVidFrame(vidFrame, ocr);
+                frameNo = ocr.confident ? n : frameNo + 1;
+        }
+        return true;
+}
+
+/** static Rect follow_crop(const framerec& d, int tagIdx, const OverlayContext& ctx, Size frameSize, Size cropSize, Point2d& centre)
+ * \brief Crop of cropSize centred on the tag, kept inside the frame. The
+ *        centre stays where the tag was last seen while it is not detected.
+ */
+static Rect follow_crop(const framerec& d, int tagIdx, const OverlayContext& ctx, Size frameSize, Size cropSize, Point2d& centre) {
+        if (d.tags[tagIdx].x >= 0) {
+                centre = ctx.to_video(d.tags[tagIdx].x, d.tags[tagIdx].y);
+        }
+        int x = (int)centre.x - cropSize.width / 2;
+        int y = (int)centre.y - cropSize.height / 2;
+        x = max(0, min(x, frameSize.width - cropSize.width));
+        y = max(0, min(y, frameSize.height - cropSize.height));
+        return Rect(x, y, cropSize.width, cropSize.height);
+}
+
+string focus_output_name(const string& output, int tag) {
+        size_t dot = output.find_last_of('.');
+        size_t slash = output.find_last_of('/');
+        if (dot == string::npos || (slash != string::npos && dot < slash)) dot = output.size();
+        return output.substr(0, dot) + "_" + to_string(tag) + output.substr(dot);
+}
+
+// Video read by one job: a file opened by OpenCV or a raw frame stream
+struct VideoInput {
+        VideoCapture capture;
+        RawVideoReader raw;
+        bool isRaw;
+        double rate;
+
+        bool read(Mat& m) {
+                if (isRaw) return raw.read(m);
+                capture >> m;
+                return !m.empty();
+        }
+        double fps() const { return isRaw ? rate : capture.get(CAP_PROP_FPS); }
+        Size size() const {
+                if (isRaw) return raw.size();
+                return Size((int)capture.get(CAP_PROP_FRAME_WIDTH), (int)capture.get(CAP_PROP_FRAME_HEIGHT));
+        }
+};
+
+// Video written by one job: the whole frame or a crop following a tag
+struct OutputClip {
+        string filename;
+        int tagIdx;             // followed tag, -1 for the whole frame
+        Point2d centre;         // last known position of the tag
+};
+
+/** class ClipEncoder
+ * \brief Writer of one output video. When started, frames are queued and
+ *        encoded on a thread of its own, so several outputs encode in
+ *        parallel; otherwise write() encodes on the calling thread.
+ */
+class ClipEncoder {
+public:
+        ClipEncoder(StageStats& stats, Semaphore* limit) : queue(8), stats(stats), limit(limit), isRaw(false) {}
+        ~ClipEncoder() { finish(); }
+
+        bool open(const string& filename, int codec, double fps, Size size) {
+                name = filename;
+                return writer.open(filename, codec, fps, size, true);
+        }
+
+        // Writes raw BGR frames instead of encoding them
+        bool open_raw(const string& filename) {
+                name = filename;
+                isRaw = true;
+                return raw.open(filename);
+        }
+
+        void start() {
+                worker = thread([this] {
+                        try {
+                                Mat m;
+                                while (queue.pop(m)) {
+                                        encode(m);
+                                }
+                        } catch (...) {
+                                err = current_exception();
+                                queue.close();
+                        }
+                });
+        }
+
+        void write(const Mat& m) {
+                if (!worker.joinable()) {
+                        encode(m);
+                } else if (!queue.push(m)) {
+                        finish();
+                        rethrow_exception(err);
+                }
+        }
+
+        // Waits until the queued frames are encoded
+        void finish() {
+                queue.close();
+                if (worker.joinable()) worker.join();
+        }
+
+        exception_ptr error() const { return err; }
+
+private:
+        void encode(const Mat& m) {
+                SemaphoreGuard encoder(limit);
+                StageTimer t(stats, STAGE_ENCODE);
+                if (!isRaw) {
+                        writer << m;
+                } else if (!raw.write(m)) {
+                        throw runtime_error("CANNOT_WRITE_FILE " + name);
+                }
+        }
+
+        string name;
+        VideoWriter writer;
+        BoundedQueue <Mat> queue;
+        StageStats& stats;
+        Semaphore* limit;
+        bool isRaw;
+        RawVideoWriter raw;
+        thread worker;
+        exception_ptr err;
+};
+
+void draw_render_frame(const OverlayContext& ctx, const RenderOptions& opts, Size frameSize, OverlayFrame& f) {
+        if (f.vidFrame.size() != frameSize) {
+                Mat small;
+                resize(f.vidFrame, small, frameSize, 0, 0, INTER_AREA);
+                f.vidFrame = small;
+        }
+        if (opts.sparse) {
+                // one layer per overlay worker, reused across frames
+                thread_local OverlayLayer layer;
+                draw_overlay(ctx, f, layer, opts.opacity);
+        } else {
+                draw_overlay(ctx, f);
+        }
+}
+
+Size scaled_size(Size input, double scale) {
+        if (scale == 1.0) return input;
+        return Size(max(1, (int)lround(input.width * scale)), max(1, (int)lround(input.height * scale)));
+}
+
+void init_overlay_context(OverlayContext& ctx, const SharedData& shared, const RenderOptions& opts, Size frameSize,
+                          const TrajectoryHistory* history, unique_ptr <LabelCache>& scaledLabels) {
+        ctx.history = history;
+        ctx.scW = frameSize.width / ((double) IMAGE_WIDTH);
+        ctx.scH = frameSize.height / ((double) IMAGE_HEIGHT);
+        ctx.drawScale = opts.scale;
+        ctx.queenId = opts.queenId;
+        ctx.hil = 5.0; // Heading indicator length
+        ctx.frameOfDeath = shared.frameOfDeath;
+        ctx.interactions = &shared.interactions;
+        ctx.showInteractions = shared.hasInteractions;
+        ctx.labels = &shared.labels;
+        ctx.angles = &shared.angles;
+        if (opts.scale != 1.0) {
+                // labels rendered for the output size
+                scaledLabels.reset(new LabelCache(FONT_HERSHEY_SCRIPT_SIMPLEX, 0.4 * opts.scale, 1));
+                ctx.labels = scaledLabels.get();
+        }
+}
+
+static bool render(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, string& error) {
+        VideoInput input;
+        input.isRaw = opts.rawIn;
+        input.rate = opts.rawFps;
+        if (opts.rawIn ? !input.raw.open(job.video, opts.rawSize) : !input.capture.open(job.video)) {
+                error = "Unable to open: " + job.video;
+                return false;
+        }
+
+        // Frames are downscaled after the frame number is read, everything
+        // downstream works at the output size
+        const Size inputSize = input.size();
+        const Size frameSize = scaled_size(inputSize, opts.scale);
+        const Point2d frameCentre(frameSize.width / 2.0, frameSize.height / 2.0);
+
+        // Output videos: the whole frame, or one crop per followed tag
+        vector <OutputClip> clips;
+        vector <int> followed(opts.focusTags);
+        if (opts.followTag >= 0) followed.insert(followed.begin(), opts.followTag);
+        for (size_t k = 0; k < followed.size(); k++) {
+                OutputClip c;
+                if (!find_idx(followed[k], c.tagIdx)) {
+                        error = "TAG_NOT_FOUND " + to_string(followed[k]);
+                        return false;
+                }
+                bool isFollow = opts.followTag >= 0 && k == 0;
+                c.filename = isFollow ? job.output : focus_output_name(job.output, followed[k]);
+                c.centre = frameCentre;
+                clips.push_back(c);
+        }
+        Size outSize = frameSize;
+        if (clips.empty()) {
+                OutputClip c;
+                c.filename = job.output;
+                c.tagIdx = -1;
+                clips.push_back(c);
+        } else {
+                outSize = Size(min(opts.cropSize, frameSize.width), min(opts.cropSize, frameSize.height));
+        }
+
+        StageStats stats(opts.stats || !opts.statsFile.empty());
+        #if CV_MAJOR_VERSION >= 4
+        int codec = VideoWriter::fourcc('D', 'I', 'V', '3');
+        #else
+        int codec = CV_FOURCC('D', 'I', 'V', '3');
+        #endif
+        if (opts.rawOut && clips.size() > 1 && job.output == "-") {
+                error = "Several clips cannot be written to the standard output";
+                return false;
+        }
+        vector <unique_ptr <ClipEncoder> > encoders;
+        for (size_t k = 0; k < clips.size(); k++) {
+                encoders.push_back(unique_ptr <ClipEncoder>(new ClipEncoder(stats, opts.encoders)));
+                bool opened = opts.rawOut ? encoders[k]->open_raw(clips[k].filename) : encoders[k]->open(clips[k].filename, codec, input.fps(), outSize);
+                if (!opened) {
+                        error = "Could not open the output video for write: " + clips[k].filename;
+                        return false;
+                }
+                // several clips of the same frames are encoded in parallel
+                if (clips.size() > 1) encoders[k]->start();
+        }
+
+        DatFile fdat;
+        if (!fdat.exists(job.dat)) {
+                error = "fdat file does not exist: " + job.dat;
+                return false;
+        }
+        fdat.open(job.dat, true);
+
+        const int threads = opts.threads;
+        const bool interactions = shared.hasInteractions;
+        InteractionTimeline timeline(shared.interactions);
+
+        const int tl = max(2, opts.tl);
+        size_t depth = 4 * threads; // frames in flight in the pipeline
+        // slots of in-flight frames and of their trajectories are never overwritten
+        TrajectoryHistory history(tl + depth);
+
+        OverlayContext ctx;
+        unique_ptr <LabelCache> scaledLabels;
+        init_overlay_context(ctx, shared, opts, frameSize, &history, scaledLabels);
+
+        const bool show = opts.show;
+        if (show) {
+                namedWindow("Current frame", WINDOW_AUTOSIZE);
+        }
+
+        // Clip to render, in printed frame numbers
+        bool partial = opts.hasStartFrame || opts.hasEndFrame || opts.hasStartTime || opts.hasEndTime;
+        uint32_t startFrame = 0;
+        uint32_t endFrame = UINT32_MAX;
+        Mat pendingFrame;          // first frame of the clip, decoded while seeking
+        uint32_t pendingFrameNo = 0;
+        bool lateStart = false;    // the clip starts after the first frame of the video
+        if (partial) {
+                if (!input.read(pendingFrame)) {
+                        error = "Unable to read: " + job.video;
+                        return false;
+                }
+                uint32_t firstFrameNo = getVidFrame(pendingFrame);
+                pendingFrameNo = firstFrameNo;
+                double fps = input.fps();
+                if (opts.hasStartFrame) startFrame = opts.startFrame;
+                else if (opts.hasStartTime) startFrame = firstFrameNo + (uint32_t)(opts.startTime * fps);
+                if (opts.hasEndFrame) endFrame = opts.endFrame;
+                else if (opts.hasEndTime) endFrame = firstFrameNo + (uint32_t)(opts.endTime * fps);
+
+                bool found = true;
+                if (startFrame > firstFrameNo && !input.isRaw) {
+                        found = seek_video(input.capture, firstFrameNo, startFrame, pendingFrame, pendingFrameNo);
+                } else {
+                        // a stream cannot seek, skip the frames before the clip
+                        while (found && pendingFrameNo < startFrame) {
+                                found = input.read(pendingFrame);
+                                if (found) pendingFrameNo = getVidFrame(pendingFrame);
+                        }
+                }
+                if (!found) {
+                        error = "Frame " + to_string(startFrame) + " not found in " + job.video;
+                        return false;
+                }
+                startFrame = pendingFrameNo;
+                lateStart = (opts.hasStartFrame || opts.hasStartTime) && startFrame > firstFrameNo;
+                if (opts.progress) {
+                        cout << "rendering from frame " << startFrame;
+                        if (endFrame != UINT32_MAX) cout << " to frame " << endFrame;
+                        cout << endl;
+                }
+        }
+
+        unique_ptr <HeatmapSet> heat;
+        if (!opts.heatmapPrefix.empty()) {
+                heat.reset(new HeatmapSet(opts.heatmapBin, opts.heatmapTags));
+        }
+
+        DatPrefetcher prefetch(fdat);
+        FrameSync sync(prefetch, stats, job.video);
+        if (lateStart) {
+                // pre-warm the trajectory with the frames preceding the clip, as a full render would have them
+                uint32_t warm = min(startFrame, (uint32_t)(tl - 2));
+                for (uint32_t i = 0; i < warm; i++) {
+                        const framerec* d = sync.at(startFrame - warm + i);
+                        if (!d) break;
+                        history.push(*d);
+                }
+        }
+
+        // Reads the next video frame, finds its dat frame and snapshots the
+        // trajectory history the overlay needs
+        const bool cropped = clips[0].tagIdx >= 0;
+        auto readStage = [&](OverlayFrame& f) -> bool {
+                if (!pendingFrame.empty()) {
+                        f.vidFrame = pendingFrame;
+                        pendingFrame = Mat();
+                } else {
+                        StageTimer t(stats, STAGE_DECODE);
+                        if (!input.read(f.vidFrame)) return false;
+                }
+
+                OcrResult ocr;
+                uint32_t ocrFrameNo;
+                {
+                        StageTimer t(stats, STAGE_OCR);
+                        ocrFrameNo = getVidFrame(f.vidFrame, ocr);
+                }
+                f.frameNo = sync.resolve(ocrFrameNo, ocr.confident);
+                if (f.frameNo > endFrame) return false;
+
+                const framerec* d;
+                {
+                        StageTimer t(stats, STAGE_DAT);
+                        d = sync.at(f.frameNo);
+                }
+                if (!d) return false;
+
+                if (cropped) {
+                        f.crops.resize(clips.size());
+                        for (size_t k = 0; k < clips.size(); k++) {
+                                f.crops[k] = follow_crop(*d, clips[k].tagIdx, ctx, frameSize, outSize, clips[k].centre);
+                        }
+                }
+                f.histSeq = history.push(*d);
+                f.trailLen = (int)min(history.size(), (uint64_t)(tl - 1));
+                if (interactions) {
+                        timeline.seek(d->frame);
+                        f.activeInteractions = timeline.active();
+                }
+                return true;
+        };
+
+        auto drawStage = [&](OverlayFrame& f) {
+                StageTimer t(stats, STAGE_OVERLAY);
+                if (heat) {
+                        HeatmapLease buf(*heat);
+                        heat->add_frame(*buf, history, f.histSeq);
+                        if (interactions) heat->add_interactions(*buf, shared.interactions, f.activeInteractions);
+                }
+                draw_render_frame(ctx, opts, frameSize, f);
+        };
+
+        int ct = 0;
+        auto writeStage = [&](OverlayFrame& f) {
+                if (opts.progress) {
+                        if (ct++ % 100 == 0) cout << " .";
+                        if (ct % 1000 == 0) cout << endl;
+                }
+                if (cropped) {
+                        for (size_t k = 0; k < encoders.size(); k++) {
+                                encoders[k]->write(f.clips[k]);
+                        }
+                } else {
+                        encoders[0]->write(f.vidFrame);
+                }
+                stats.count_frame();
+                if (show) {
+                        imshow("Current frame", cropped ? f.clips[0] : f.vidFrame);
+                        waitKey(1); // lets the window repaint, --view for interactive review
+                }
+        };
+
+        if (opts.progress) cout << "start processing files" << endl;
+        stats.start();
+        run_ordered_pipeline<OverlayFrame>(threads, depth, readStage, drawStage, writeStage);
+        for (size_t k = 0; k < encoders.size(); k++) {
+                encoders[k]->finish();
+                if (encoders[k]->error()) rethrow_exception(encoders[k]->error());
+        }
+        stats.stop();
+        if (input.isRaw && input.raw.error()) {
+                error = "CANNOT_READ_FILE " + job.video + ": " + strerror(input.raw.error());
+                return false;
+        }
+        if (input.isRaw && input.raw.truncated()) {
+                cerr << "TRUNCATED_FRAME at the end of " << job.video << endl;
+        }
+
+        if (opts.progress) cout << endl;
+        for (size_t k = 0; k < clips.size(); k++) {
+                cout << "Video written to: " << clips[k].filename << endl;
+        }
+        const SyncCounters& sc = sync.counters();
+        if (stats.enabled() || sc.gaps + sc.duplicates + sc.misreads + sc.discontinuities > 0) {
+                sync.print_summary(cout);
+        }
+        if (stats.enabled()) {
+                stats.print_summary(cout);
+        }
+        if (heat && !heat->write(opts.heatmapPrefix, opts.heatmapFormat, error)) {
+                return false;
+        }
+        if (!opts.statsFile.empty() && !stats.write_report(opts.statsFile)) {
+                cerr << "CANNOT_WRITE_FILE " << opts.statsFile << endl;
+        }
+        return true;
+}
+
+bool render_video(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, string& error) {
+        try {
+                return render(job, shared, opts, error);
+        } catch (const cv::Exception& e) {
+                error = e.what();
+        } catch (const exception& e) {
+                error = e.what();
+        }
+        return false;
+}
@@ -0,0 +1,128 @@
+/*
+ * render.hpp
+ *
+ *  Rendering of one tracking video: decoding, frame number OCR, dat
+ *  synchronisation, overlay drawing and encoding.
+ *
+ */
+
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "interactions.hpp"
+#include "overlay.hpp"
+#include "pipeline.hpp"
+
+// Data loaded once and shared by all videos rendered by the process
+struct SharedData {
+        SharedData();
+
+        /** void load_tags(const std::string& filename)
+         * \brief Reads the .tags file and fills frameOfDeath
+         */
+        void load_tags(const std::string& filename);
+
+        int frameOfDeath[1024];
+        InteractionStore interactions;
+        bool hasInteractions;
+        LabelCache labels;
+        AngleTable angles;
+};
+
+// Input and output files of one video
+struct RenderJob {
+        std::string video;
+        std::string dat;
+        std::string output;
+};
+
+struct RenderOptions {
+        RenderOptions();
+
+        bool rawIn;             // the video is a stream of raw BGR frames of rawSize
+        cv::Size rawSize;
+        double rawFps;
+        bool rawOut;            // write raw BGR frames instead of encoding
+
+        int threads;            // overlay workers
+        int tl;                 // Length of the trajectory printed in the video
+        int queenId;
+        bool show;              // preview window (main thread only)
+        bool progress;          // print progress dots
+        bool hasStartFrame;
+        bool hasEndFrame;
+        bool hasStartTime;
+        bool hasEndTime;
+        uint32_t startFrame;
+        uint32_t endFrame;
+        double startTime;
+        double endTime;
+        double scale;           // output size relative to the input video
+        bool sparse;            // draw through an OverlayLayer
+        double opacity;         // of the overlay layer
+        int followTag;          // output only a crop following this tag (-1: whole frame)
+        std::vector <int> focusTags; // write a crop per tag to <output>_<tag> instead of the whole frame
+        int cropSize;           // side of these crops in pixels
+        std::string heatmapPrefix;      // write heatmaps to <prefix>_*, empty for none
+        std::string heatmapFormat;      // png, npy or both
+        int heatmapBin;                 // heatmap cell side in dat pixels
+        std::vector <int> heatmapTags;  // tags with an occupancy map of their own
+        bool stats;
+        std::string statsFile;
+        Semaphore* encoders;    // limits concurrent encoder calls (may be null)
+};
+
+/** bool render_video(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, std::string& error)
+ * \brief Overlays the tracking data of job.dat on job.video and writes job.output
+ * \param error Set to the reason of a failure
+ * \return false if the job failed
+ */
+bool render_video(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, std::string& error);
+
+/** cv::Size scaled_size(cv::Size input, double scale)
+ * \brief Size of the frames drawn on, for input frames of the video
+ */
+cv::Size scaled_size(cv::Size input, double scale);
+
+/** void init_overlay_context(OverlayContext& ctx, const SharedData& shared, const RenderOptions& opts, cv::Size frameSize, const TrajectoryHistory* history, std::unique_ptr <LabelCache>& scaledLabels)
+ * \brief Overlay settings for frames of frameSize (after scaling)
+ * \param scaledLabels Receives the labels rendered for opts.scale, if it is not 1
+ */
+void init_overlay_context(OverlayContext& ctx, const SharedData& shared, const RenderOptions& opts, cv::Size frameSize,
+                          const TrajectoryHistory* history, std::unique_ptr <LabelCache>& scaledLabels);
+
+/** void draw_render_frame(const OverlayContext& ctx, const RenderOptions& opts, cv::Size frameSize, OverlayFrame& f)
+ * \brief Overlay stage of render(): shrinks f.vidFrame to frameSize if
+ *        needed and draws the overlay, through a per-thread OverlayLayer
+ *        reused across frames with opts.sparse. Safe to call concurrently.
+ */
+void draw_render_frame(const OverlayContext& ctx, const RenderOptions& opts, cv::Size frameSize, OverlayFrame& f);
+
+/** std::string focus_output_name(const std::string& output, int tag)
+ * \brief Name of the clip following tag: the output name with _<tag> before its extension
+ */
+std::string focus_output_name(const std::string& output, int tag);
+
+/** bool seek_video(cv::VideoCapture& capture, uint32_t firstFrameNo, uint32_t target, cv::Mat& vidFrame, uint32_t& frameNo)
+ * \brief Positions the video on the frame whose printed number is target.
+ *        Jumps to the expected position, corrects it with the number read
+ *        from the frame and reads forward over the last few frames. A
+ *        landing past the target or on an unreadable counter steps back by
+ *        a bounded margin, never to the start of the video. If the counter
+ *        stays unreadable there, reading resumes from the closest position
+ *        whose number was read before the target.
+ * \param firstFrameNo Number printed in the first frame of the video
+ * \param vidFrame Receives the first frame of the clip (already decoded)
+ * \param frameNo Receives its printed number
+ * \return false if the end of the video is reached before target, or
+ *         the target cannot be located
+ */
+bool seek_video(cv::VideoCapture& capture, uint32_t firstFrameNo, uint32_t target, cv::Mat& vidFrame, uint32_t& frameNo);
+
+#endif // RENDER_HPP
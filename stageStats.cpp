@@ -0,0 +1,136 @@
+/*
+ * stageStats.cpp
+ *
+ *  Per-stage timing of the rendering pipeline, see stageStats.hpp.
+ *
+ */
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "stageStats.hpp"
+
+using namespace std;
+
+static const char* stageNames[STAGE_COUNT] = {"decode", "ocr", "dat", "overlay", "encode"};
+
+StageStats::StageStats(bool enabled) : on(enabled), frames(0), resyncs(0) {
+        for (int s = 0; s < STAGE_COUNT; s++) {
+                samples[s] = 0;
+                totalNs[s] = 0;
+                maxNs[s] = 0;
+                for (int b = 0; b < bucketCount; b++) {
+                        hist[s][b] = 0;
+                }
+        }
+        t0 = t1 = chrono::steady_clock::now();
+}
+
+void StageStats::start() {
+        t0 = t1 = chrono::steady_clock::now();
+}
+
+void StageStats::stop() {
+        t1 = chrono::steady_clock::now();
+}
+
+int StageStats::bucket_of(int64_t ns) {
+        if (ns < 1) return 0;
+        int b = (int)(log2((double)ns) * bucketsPerOctave);
+        return b < bucketCount ? b : bucketCount - 1;
+}
+
+// representative value (geometric middle) of a bucket, in seconds
+double StageStats::bucket_value(int b) {
+        return exp2((b + 0.5) / bucketsPerOctave) * 1e-9;
+}
+
+void StageStats::record(Stage s, chrono::steady_clock::duration d) {
+        if (!on) return;
+        int64_t ns = chrono::duration_cast<chrono::nanoseconds>(d).count();
+        samples[s].fetch_add(1, memory_order_relaxed);
+        totalNs[s].fetch_add(ns, memory_order_relaxed);
+        hist[s][bucket_of(ns)].fetch_add(1, memory_order_relaxed);
+        int64_t m = maxNs[s].load(memory_order_relaxed);
+        while (ns > m && !maxNs[s].compare_exchange_weak(m, ns, memory_order_relaxed)) {
+        }
+}
+
+double StageStats::percentile(Stage s, double p) const {
+        uint64_t n = samples[s].load();
+        if (n == 0) return 0.0;
+        uint64_t rank = (uint64_t)ceil(p / 100.0 * n);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < bucketCount; b++) {
+                seen += hist[s][b].load();
+                if (seen >= rank) return min(bucket_value(b), maxNs[s].load() * 1e-9);
+        }
+        return maxNs[s].load() * 1e-9;
+}
+
+void StageStats::print_summary(ostream& dst) const {
+        double wall = chrono::duration<double>(t1 - t0).count();
+        uint64_t n = frames.load();
+        // formatted apart: the caller's stream keeps its precision and flags
+        ostringstream out;
+        out << fixed << setprecision(3);
+        out << "frames: " << n << "  wall: " << wall << " s  throughput: " << (wall > 0 ? n / wall : 0.0) << " frames/s" << endl;
+        out << "dat resyncs: " << resyncs.load() << "  peak RSS: " << peak_rss() / (1024.0 * 1024.0) << " MB" << endl;
+        out << setw(10) << "stage" << setw(10) << "samples" << setw(12) << "total s" << setw(12) << "mean ms"
+            << setw(12) << "p50 ms" << setw(12) << "p90 ms" << setw(12) << "p99 ms" << setw(12) << "max ms" << endl;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+                uint64_t k = samples[s].load();
+                double total = totalNs[s].load() * 1e-9;
+                out << setw(10) << stageNames[s] << setw(10) << k << setw(12) << total
+                    << setw(12) << (k ? total / k * 1e3 : 0.0)
+                    << setw(12) << percentile((Stage)s, 50) * 1e3
+                    << setw(12) << percentile((Stage)s, 90) * 1e3
+                    << setw(12) << percentile((Stage)s, 99) * 1e3
+                    << setw(12) << maxNs[s].load() * 1e-6 << endl;
+        }
+        dst << out.str();
+}
+
+bool StageStats::write_report(const string& filename) const {
+        ofstream f(filename.c_str());
+        if (!f.is_open()) return false;
+        double wall = chrono::duration<double>(t1 - t0).count();
+        uint64_t n = frames.load();
+        double fps = wall > 0 ? n / wall : 0.0;
+        bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+        f << setprecision(9);
+        if (json) {
+                f << "{\n  \"frames\": " << n << ",\n  \"wall_s\": " << wall << ",\n  \"fps\": " << fps
+                  << ",\n  \"dat_resyncs\": " << resyncs.load() << ",\n  \"peak_rss_bytes\": " << peak_rss() << ",\n  \"stages\": {\n";
+                for (int s = 0; s < STAGE_COUNT; s++) {
+                        uint64_t k = samples[s].load();
+                        double total = totalNs[s].load() * 1e-9;
+                        f << "    \"" << stageNames[s] << "\": {\"samples\": " << k << ", \"total_s\": " << total
+                          << ", \"mean_s\": " << (k ? total / k : 0.0)
+                          << ", \"p50_s\": " << percentile((Stage)s, 50) << ", \"p90_s\": " << percentile((Stage)s, 90)
+                          << ", \"p99_s\": " << percentile((Stage)s, 99) << ", \"max_s\": " << maxNs[s].load() * 1e-9 << "}"
+                          << (s + 1 < STAGE_COUNT ? "," : "") << "\n";
+                }
+                f << "  }\n}\n";
+        } else {
+                f << "stage,samples,total_s,mean_s,p50_s,p90_s,p99_s,max_s,frames,wall_s,fps,dat_resyncs,peak_rss_bytes\n";
+                for (int s = 0; s < STAGE_COUNT; s++) {
+                        uint64_t k = samples[s].load();
+                        double total = totalNs[s].load() * 1e-9;
+                        f << stageNames[s] << "," << k << "," << total << "," << (k ? total / k : 0.0) << ","
+                          << percentile((Stage)s, 50) << "," << percentile((Stage)s, 90) << "," << percentile((Stage)s, 99) << ","
+                          << maxNs[s].load() * 1e-9 << "," << n << "," << wall << "," << fps << "," << resyncs.load() << "," << peak_rss() << "\n";
+                }
+        }
+        return f.good();
+}
+
+size_t peak_rss() {
+        struct rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+        return (size_t)ru.ru_maxrss * 1024; // kilobytes on Linux
+}
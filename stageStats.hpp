@@ -0,0 +1,95 @@
+/*
+ * stageStats.hpp
+ *
+ *  Per-stage timing of the rendering pipeline (--stats). Latencies are
+ *  accumulated in logarithmic histograms with atomic counters, so stages
+ *  running on several threads can record without locking.
+ *
+ */
+
+#ifndef STAGE_STATS_HPP
+#define STAGE_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum Stage {
+        STAGE_DECODE,
+        STAGE_OCR,
+        STAGE_DAT,
+        STAGE_OVERLAY,
+        STAGE_ENCODE,
+        STAGE_COUNT
+};
+
+class StageStats {
+public:
+        explicit StageStats(bool enabled);
+
+        bool enabled() const { return on; }
+
+        // Starts the wall clock of the run
+        void start();
+        // Stops the wall clock of the run
+        void stop();
+
+        void record(Stage s, std::chrono::steady_clock::duration d);
+        void count_frame() { if (on) frames.fetch_add(1, std::memory_order_relaxed); }
+        void count_resync() { if (on) resyncs.fetch_add(1, std::memory_order_relaxed); }
+
+        /** double percentile(Stage s, double p) const
+         * \brief Approximate latency percentile of a stage in seconds (within 1/16 octave)
+         */
+        double percentile(Stage s, double p) const;
+
+        void print_summary(std::ostream& out) const;
+
+        /** bool write_report(const std::string& filename) const
+         * \brief Writes the summary as JSON if filename ends with .json, as CSV otherwise
+         */
+        bool write_report(const std::string& filename) const;
+
+private:
+        // 16 buckets per power of two of nanoseconds, up to ~2^40 ns
+        static const int bucketsPerOctave = 16;
+        static const int bucketCount = 40 * bucketsPerOctave;
+
+        static int bucket_of(int64_t ns);
+        static double bucket_value(int b);
+
+        bool on;
+        std::chrono::steady_clock::time_point t0;
+        std::chrono::steady_clock::time_point t1;
+        std::atomic <uint64_t> frames;
+        std::atomic <uint64_t> resyncs;
+        std::atomic <uint64_t> samples[STAGE_COUNT];
+        std::atomic <int64_t> totalNs[STAGE_COUNT];
+        std::atomic <int64_t> maxNs[STAGE_COUNT];
+        std::atomic <uint32_t> hist[STAGE_COUNT][bucketCount];
+};
+
+/** class StageTimer
+ * \brief Records the lifetime of the timer as one sample of a stage
+ */
+class StageTimer {
+public:
+        StageTimer(StageStats& stats, Stage s) : stats(stats), stage(s) {
+                if (stats.enabled()) begin = std::chrono::steady_clock::now();
+        }
+        ~StageTimer() {
+                if (stats.enabled()) stats.record(stage, std::chrono::steady_clock::now() - begin);
+        }
+
+private:
+        StageStats& stats;
+        Stage stage;
+        std::chrono::steady_clock::time_point begin;
+};
+
+// Peak resident set size of the process in bytes
+size_t peak_rss();
+
+#endif // STAGE_STATS_HPP
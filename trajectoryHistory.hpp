@@ -0,0 +1,95 @@
+/*
+ * trajectoryHistory.hpp
+ *
+ *  Fixed capacity ring buffer of the recent tag positions used to draw the
+ *  trajectories. Positions are stored per tag (x, y and angle in separate
+ *  arrays, slots of a tag contiguous) with a presence bitmap per frame, and
+ *  are only written for the tags detected in a frame. Each frame also keeps
+ *  the compacted list of its detected tags.
+ *
+ */
+
+#ifndef TRAJECTORY_HISTORY_HPP
+#define TRAJECTORY_HISTORY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "anttrackingUNIL/datfile.h"
+
+class TrajectoryHistory {
+public:
+        /** TrajectoryHistory(int capacity)
+         * \param capacity Number of frames kept. Frames pushed more than
+         *        capacity frames ago are overwritten.
+         */
+        explicit TrajectoryHistory(int capacity) :
+                cap(capacity > 0 ? capacity : 1), words((tag_count + 63) / 64), pushed(0),
+                xs(tag_count * cap), ys(tag_count * cap), as(tag_count * cap),
+                presence(words * cap), frames(cap), detected(tag_count * cap), detectedCount(cap) {}
+
+        /** uint64_t push(const framerec& f)
+         * \brief Records the positions of the tags detected in f
+         * \return Sequence number of the recorded frame
+         */
+        uint64_t push(const framerec& f) {
+                const uint64_t seq = pushed++;
+                const size_t slot = seq % cap;
+                uint64_t* bits = &presence[slot * words];
+                memset(bits, 0, words * sizeof(uint64_t));
+                frames[slot] = f.frame;
+                uint16_t* list = &detected[slot * tag_count];
+                uint16_t n = 0;
+                for (int tag = 0; tag < tag_count; tag++) {
+                        if (f.tags[tag].x >= 0) {
+                                bits[tag >> 6] |= (uint64_t)1 << (tag & 63);
+                                list[n++] = tag;
+                                const size_t k = (size_t)tag * cap + slot;
+                                xs[k] = f.tags[tag].x;
+                                ys[k] = f.tags[tag].y;
+                                as[k] = f.tags[tag].a;
+                        }
+                }
+                detectedCount[slot] = n;
+                return seq;
+        }
+
+        // Forgets all frames, sequence numbers restart at 0
+        void clear() { pushed = 0; }
+
+        // Number of frames pushed so far
+        uint64_t size() const { return pushed; }
+        int capacity() const { return cap; }
+
+        uint32_t frame(uint64_t seq) const { return frames[seq % cap]; }
+
+        bool present(uint64_t seq, int tag) const {
+                return (presence[(seq % cap) * words + (tag >> 6)] >> (tag & 63)) & 1;
+        }
+
+        // Indices (into tag_list) of the tags detected in a frame, in increasing order
+        const uint16_t* detected_tags(uint64_t seq) const { return &detected[(seq % cap) * tag_count]; }
+        int detected_count(uint64_t seq) const { return detectedCount[seq % cap]; }
+
+        int16_t x(uint64_t seq, int tag) const { return xs[(size_t)tag * cap + seq % cap]; }
+        int16_t y(uint64_t seq, int tag) const { return ys[(size_t)tag * cap + seq % cap]; }
+        int16_t a(uint64_t seq, int tag) const { return as[(size_t)tag * cap + seq % cap]; }
+
+private:
+        TrajectoryHistory(const TrajectoryHistory&);
+        TrajectoryHistory& operator=(const TrajectoryHistory&);
+
+        const size_t cap;
+        const size_t words;      // presence words per frame
+        uint64_t pushed;
+        std::vector <int16_t> xs;
+        std::vector <int16_t> ys;
+        std::vector <int16_t> as;
+        std::vector <uint64_t> presence;
+        std::vector <uint32_t> frames;
+        std::vector <uint16_t> detected;
+        std::vector <uint16_t> detectedCount;
+};
+
+#endif // TRAJECTORY_HISTORY_HPP
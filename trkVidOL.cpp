@@ -8,11 +8,15 @@
 
 #include <iostream>
 #include <string>
+#include <fstream>
 #include <sstream>
 #include <cmath>
 #include <vector>
-#include <deque>
 #include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <charconv>
+#include <csignal>
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
@@ -23,350 +27,262 @@
 #include "anttrackingUNIL/tags3.h"
 #include "anttrackingUNIL/datfile.h"
 
-#include "numPatterns.hpp"
+#include "interactions.hpp"
+#include "interactionCache.hpp"
+#include "pipeline.hpp"
+#include "render.hpp"
+#include "viewer.hpp"
 
 using namespace cv;
 using namespace std;
 
-const int tl = 10; // Length of the trajectory printed in the video
-
-// Extract frame number
-const int len = 9;
-const int xOffset = 54;
-const int yOffset = 2;
-const int width = 7;
-const int height = 10;
-
 const char* params =
         "{ help h       | | Print usage }"
         "{ trkVid v     | | Path to a tracking video }"
         "{ fDat d       | | Path to a .dat file }"
         "{ fTags t      | | Path to a .tags file }"
         "{ fInteract i  | | Path to an interaction (.txt) file }"
+        "{ noCache      | | Do not read or write the binary interaction cache (<fInteract>.trkcache) and frame index (<trkVid>.trkidx) }"
         "{ fVidOut vo   | | Name for outpu video file (has to be .avi) }"
-        "{ show s       | | Show video preview }";
-
-// structure of an interaction
-struct data {
-        double time_start;
-        double time_stop;
-        uint32_t frame_start;       // frame of interaction
-        uint32_t frame_stop;        // frame of end of interaction (filled only during filtering)
-        uint16_t box;
-        //coor ant 1
-        uint16_t x1;
-        uint16_t y1;
-        int16_t a1;
-        // coor ant 2
-        uint16_t x2;
-        uint16_t y2;
-        int16_t a2;
-        int det;
-        int direction;     // direction of interaction (1: ant1 interacts, 2: ant2 interacts, 3:both ants interact);
-};
-
-// INteraction event
-struct event {
-        uint16_t tag1;
-        uint16_t tag2;
-        data d;
-        char s;       // state of interaction: long, blinking
-};
-
-typedef vector <data> interactions;
-typedef vector <vector <int> > matrice;
-
-// convert a tag in the corresponding index of the tag_list table
-bool find_idx(const int tag, int& idx){
-        int i(0);
-        do {
-                if (tag == tag_list[i]) {
-                        idx = i;
-                        return true;
+        "{ show s       | | Show video preview }"
+        "{ view         | | Interactive viewer with a frame trackbar instead of rendering (space: play / pause, a d: step, q: quit) }"
+        "{ viewCache    |1024| Memory in MB for the frames kept by the viewer }"
+        "{ threads j    |0| Number of overlay worker threads (0: all cores but two, at least 1; 1: serial) }"
+        "{ trail        |10| Length of the trajectory printed in the video }"
+        "{ startFrame   | | First frame to render (frame number printed in the video) }"
+        "{ endFrame     | | Last frame to render (frame number printed in the video) }"
+        "{ startTime    | | Start of the rendered clip in seconds from the start of the video }"
+        "{ endTime      | | End of the rendered clip in seconds from the start of the video }"
+        "{ rawIn        | | trkVid is a stream of raw BGR frames of this size (WxH), - for the standard input }"
+        "{ rawFps       |25| Frame rate of a raw input stream }"
+        "{ rawOut       | | Write raw BGR frames to fVidOut instead of an encoded video, - for the standard output }"
+        "{ scale        |1.0| Output size relative to the input video, e.g. 0.5 for a quick review render }"
+        "{ sparseOverlay | | Draw the overlay into a tiled layer blended onto the frame only where something is drawn }"
+        "{ overlayAlpha |1.0| Opacity of the overlay layer (below 1 implies --sparseOverlay) }"
+        "{ followTag    | | Output only a crop of the video following this tag }"
+        "{ focusTags    | | Comma separated tags, writes a crop following each to <fVidOut>_<tag>.avi in the same pass, instead of fVidOut }"
+        "{ cropSize     |400| Side in pixels of the crops following --followTag and --focusTags }"
+        "{ heatmap      | | Also write occupancy and interaction heatmaps to <heatmap>_occupancy, _tag<N>, _box<B> }"
+        "{ heatmapFormat |png| Heatmap files: png (color image), npy (uint32 array) or both }"
+        "{ heatmapBin   |8| Side of a heatmap cell in dat pixels }"
+        "{ heatmapTags  | | Comma separated tags with an occupancy heatmap of their own }"
+        "{ stats        | | Print per-stage timings, throughput and memory use at the end }"
+        "{ statsFile    | | Also write the timings to a report (.json or .csv) }"
+        "{ batch b      | | Manifest of videos to render, one \"trkVid fDat fVidOut\" job per line }"
+        "{ jobs         |0| Number of videos rendered at once in batch mode (0: cores / 4) }"
+        "{ maxEncoders  |0| Maximum number of videos encoding at once in batch mode (0: no limit) }";
+
+/** bool parse_tag_list(const string& list, vector <int>& tags)
+ * \brief Tags of a comma separated list
+ * \return false (and prints INVALID_TAG) if a field is not a whole number
+ */
+bool parse_tag_list(const string& list, vector <int>& tags) {
+        tags.clear();
+        stringstream ss(list);
+        string tag;
+        while (getline(ss, tag, ',')) {
+                size_t b = tag.find_first_not_of(" \t");
+                if (b == string::npos) continue;
+                size_t e = tag.find_last_not_of(" \t") + 1;
+                int value;
+                from_chars_result r = from_chars(tag.data() + b, tag.data() + e, value);
+                if (r.ec != errc() || r.ptr != tag.data() + e) {
+                        cerr << "INVALID_TAG " << tag.substr(b, e - b) << " in " << list << endl;
+                        return false;
                 }
-                i++;
-        } while(idx == -1 && i<tag_count);
-        return false;
+                tags.push_back(value);
+        }
+        return true;
 }
 
-// function to compare elements of vector
-bool cmp(const event& a, const event& b){
-        return a.d.frame_start < b.d.frame_start;
+/** string job_file_name(const string& output, const string& name)
+ * \brief Name of a per-video file in batch mode: <output>.<name> next to the
+ *        output, or in the directory of name if it has one
+ */
+string job_file_name(const string& output, const string& name) {
+        size_t slash = name.rfind('/');
+        if (slash == string::npos) return output + "." + name;
+        size_t outSlash = output.rfind('/');
+        string base = outSlash == string::npos ? output : output.substr(outSlash + 1);
+        return name.substr(0, slash + 1) + base + "." + name.substr(slash + 1);
 }
 
-/** void read_interaction_file(char* filename, vector <vector <interactions> >& i_table)
- * \brief Opens input file with list of interactions (expected format is frame,box,IDant1,IDant2,x1,y1,a1,x2,y2,a2)
- *		reads them into a 3 dimensional vector
- * \param filename Name of the input file to read
- * \param i_table Table of interactions to fill
+/** bool read_manifest(const string& filename, vector <RenderJob>& jobs)
+ * \brief Reads a batch manifest: one job per line with the tracking video,
+ *        the .dat file and the output video separated by white space.
+ *        Empty lines and lines starting with # are ignored.
+ * \return false if the manifest cannot be read or a line is incomplete
  */
-void read_interaction_file(string filename, vector <vector <interactions> >& i_table){
-        ifstream f;
-        f.open(filename.c_str());
+bool read_manifest(const string& filename, vector <RenderJob>& jobs) {
+        ifstream f(filename.c_str());
         if (!f.is_open()) {
                 cerr << "CANNOT_OPEN_FILE " << filename << endl;
-
-        }
-
-        string s;
-        getline(f,s);
-        while (!f.eof()) {
-                getline(f,s);
-                stringstream ss;
-                ss.str(s);
-                data temp;
-                memset(&temp, 0, sizeof(temp));
-                temp.frame_stop = 0;
-                if (!ss.fail()) {
-                        int tag1;
-                        ss >> tag1;
-                        ss.ignore(1,',');
-                        int tag2;
-                        ss >> tag2;
-                        ss.ignore(1,',');
-                        ss>>temp.frame_start;
-                        ss.ignore(1,',');
-                        ss>>temp.frame_stop;
-                        ss.ignore(1,',');
-                        ss>>temp.time_start;
-                        ss.ignore(1,',');
-                        ss>>temp.time_stop;
-                        ss.ignore(1,',');
-                        ss>>temp.box;
-                        ss.ignore(1,',');
-                        ss>>temp.x1;
-                        ss.ignore(1,',');
-                        ss>>temp.y1;
-                        ss.ignore(1,',');
-                        ss>>temp.a1;
-                        ss.ignore(1,',');
-                        ss>>temp.x2;
-                        ss.ignore(1,',');
-                        ss>>temp.y2;
-                        ss.ignore(1,',');
-                        ss>>temp.a2;
-                        ss.ignore(1,',');
-                        ss>>temp.direction;
-                        ss.ignore(1,',');
-                        ss>>temp.det;
-
-                        // find index of each tag
-                        int idx1 (-1);
-                        int idx2 (-1);
-                        if (!find_idx(tag1, idx1)) {
-                                stringstream ss;
-                                ss << tag1;
-                                string info = ss.str();
-                                cerr << "TAG_NOT_FOUND" << info << endl;
-                        }
-                        if (!find_idx(tag2, idx2)) {
-                                stringstream ss;
-                                ss << tag2;
-                                string info = ss.str();
-                                cerr << "TAG_NOT_FOUND" << info << endl;
-                        }
-
-                        // add interaction to list (matrix is symmetric)
-                        i_table[idx1][idx2].push_back(temp);
-                        i_table[idx2][idx1].push_back(temp);
-                }
+                return false;
         }
-        f.close();
-}
-
-int getVidFrame(Mat &vidFrame) {
-        uint32_t frameNo = 0;
-        for (int i = 0; i < 8; i++) { // per digit
-                uint16_t isNum = 0x3FF;
-                int vecIdx = 0;
-                for (int idx = 0; idx < len * height; idx++) { // per pixel in digit
-                        if (idx % len < width) { // ignore the filling strip on the rigth
-                                Scalar col = vidFrame.at<uchar>(idx / len + yOffset, (idx % len + len * i + xOffset) * 3);
-                                if (col[0] != zero[vecIdx*3]) isNum &= ~(0b1 << 0);
-                                if (col[0] != one[vecIdx*3]) isNum &= ~(0b1 << 1);
-                                if (col[0] != two[vecIdx*3]) isNum &= ~(0b1 << 2);
-                                if (col[0] != three[vecIdx*3]) isNum &= ~(0b1 << 3);
-                                if (col[0] != four[vecIdx*3]) isNum &= ~(0b1 << 4);
-                                if (col[0] != five[vecIdx*3]) isNum &= ~(0b1 << 5);
-                                if (col[0] != six[vecIdx*3]) isNum &= ~(0b1 << 6);
-                                if (col[0] != seven[vecIdx*3]) isNum &= ~(0b1 << 7);
-                                if (col[0] != eight[vecIdx*3]) isNum &= ~(0b1 << 8);
-                                if (col[0] != nine[vecIdx*3]) isNum &= ~(0b1 << 9);
-                                vecIdx++;
-                        }
+        string line;
+        int lineNo = 0;
+        while (getline(f, line)) {
+                lineNo++;
+                istringstream ss(line);
+                RenderJob job;
+                if (!(ss >> job.video) || job.video[0] == '#') continue;
+                if (!(ss >> job.dat >> job.output)) {
+                        cerr << filename << ":" << lineNo << ": MALFORMED_LINE " << line << endl;
+                        return false;
                 }
-                if (isNum & (0b1 << 1)) frameNo += pow(10,(7-i));
-                if (isNum & (0b1 << 2)) frameNo += pow(10,(7-i)) * 2;
-                if (isNum & (0b1 << 3)) frameNo += pow(10,(7-i)) * 3;
-                if (isNum & (0b1 << 4)) frameNo += pow(10,(7-i)) * 4;
-                if (isNum & (0b1 << 5)) frameNo += pow(10,(7-i)) * 5;
-                if (isNum & (0b1 << 6)) frameNo += pow(10,(7-i)) * 6;
-                if (isNum & (0b1 << 7)) frameNo += pow(10,(7-i)) * 7;
-                if (isNum & (0b1 << 8)) frameNo += pow(10,(7-i)) * 8;
-                if (isNum & (0b1 << 9)) frameNo += pow(10,(7-i)) * 9;
+                jobs.push_back(job);
         }
-        return frameNo;
+        return true;
 }
 
 int main(int argc, char** argv ) {
         CommandLineParser parser(argc, argv, params);
         parser.about("Program to highlight tracking video with tracking data (.tags and .dat files)");
-        if (parser.has("help") || !parser.has("fDat") || !parser.has("fTags") || !parser.has("trkVid") || !parser.has("fVidOut")) {
+        bool batch = parser.has("batch");
+        bool view = parser.has("view") && !batch;
+        if (parser.has("help") || !parser.has("fTags") || (!batch && (!parser.has("fDat") || !parser.has("trkVid") || (!view && !parser.has("fVidOut"))))) {
                 parser.printMessage();
                 return 1;
         }
-
-        VideoCapture capture(parser.get<String>("trkVid"));
-        if (!capture.isOpened()) {
-                cerr << "Unable to open: " << parser.get<String>("trkVid") << endl;
-                return 1;
+        if (parser.has("rawOut") && !batch && parser.get<String>("fVidOut") == "-") {
+                // the standard output carries the frames, messages go to the standard error
+                cout.rdbuf(cerr.rdbuf());
         }
 
-        VideoWriter outputVid;
-        #if CV_MAJOR_VERSION >= 4
-        int codec = outputVid.fourcc('D', 'I', 'V', '3');
-        #else
-        int codec = CV_FOURCC('D', 'I', 'V', '3');
-        #endif
-        outputVid.open(parser.get<String>("fVidOut"), codec, capture.get(CAP_PROP_FPS), Size((int)capture.get(CAP_PROP_FRAME_WIDTH), (int)capture.get(CAP_PROP_FRAME_HEIGHT)), true);
-        if (!outputVid.isOpened()) {
-                cout << "Could not open the output video for write" << endl;
-                return -1;
+        int cores = max(1, (int)thread::hardware_concurrency());
+        int threads = parser.get<int>("threads");
+        if (threads <= 0) {
+                threads = max(1, cores - 2);
         }
 
-        DatFile fdat;
-        if (!fdat.exists(parser.get<String>("fDat"))) {
-                cerr << "fdat file does not exist" << endl;
-                return 1;
+        vector <RenderJob> jobs;
+        if (batch) {
+                if (!read_manifest(parser.get<String>("batch"), jobs)) return 1;
+        } else {
+                RenderJob job;
+                job.video = parser.get<String>("trkVid");
+                job.dat = parser.get<String>("fDat");
+                if (!view) job.output = parser.get<String>("fVidOut");
+                jobs.push_back(job);
         }
-        fdat.open(parser.get<String>("fDat"), true);
-
-        TagsFile ftag;
-        string fname_s = parser.get<String>("fTags");
-        char fname_c[fname_s.size() + 1];
-        strcpy(fname_c, fname_s.c_str());
-        ftag.read_file(fname_c);
 
-        int frameOfDeath[1024];
-        for (int i = 0; i < 1024; i++) {
-                frameOfDeath[i] = INT_MAX;
+        // Tags and interactions are loaded once for all the videos
+        SharedData shared;
+        shared.load_tags(parser.get<String>("fTags"));
+        if (parser.has("fInteract")) {
+                shared.hasInteractions = true;
+                load_interactions(parser.get<string>("fInteract"), shared.interactions, threads, !parser.has("noCache"));
+                cout << "interactions loaded: " << shared.interactions.size() << " (" << shared.interactions.memory_usage() / (1024.0 * 1024.0) << " MB)" << endl;
         }
 
-        for (int i = 0; i < tag_count; i++) {
-                if (ftag.get_state(i) && ftag.get_death(i) > 0) {
-                        frameOfDeath[ftag.get_tag(i)] = ftag.get_death(i);
+        RenderOptions opts;
+        opts.threads = threads;
+        opts.tl = parser.get<int>("trail");
+        opts.show = parser.has("show");
+        opts.hasStartFrame = parser.has("startFrame");
+        opts.hasEndFrame = parser.has("endFrame");
+        opts.hasStartTime = parser.has("startTime");
+        opts.hasEndTime = parser.has("endTime");
+        if (opts.hasStartFrame) opts.startFrame = parser.get<uint32_t>("startFrame");
+        if (opts.hasEndFrame) opts.endFrame = parser.get<uint32_t>("endFrame");
+        if (opts.hasStartTime) opts.startTime = parser.get<double>("startTime");
+        if (opts.hasEndTime) opts.endTime = parser.get<double>("endTime");
+        if (parser.has("rawIn")) {
+                opts.rawIn = true;
+                if (sscanf(parser.get<String>("rawIn").c_str(), "%dx%d", &opts.rawSize.width, &opts.rawSize.height) != 2) {
+                        cerr << "INVALID_FRAME_SIZE " << parser.get<String>("rawIn") << " (expected WxH)" << endl;
+                        return 1;
                 }
+                opts.rawFps = parser.get<double>("rawFps");
         }
-
-        vector <vector <interactions> > i_table;
-        i_table.resize(tag_count);
-        for (int i = 0; i < tag_count; i++) {
-                i_table[i].resize(tag_count);
+        opts.rawOut = parser.has("rawOut");
+        if (opts.rawOut) {
+                // a closed pipe is reported as a write error instead of killing the process
+                signal(SIGPIPE, SIG_IGN);
         }
-        bool interactions = false;
-        if (parser.has("fInteract")) {
-                interactions = true;
-                read_interaction_file(parser.get<string>("fInteract"), i_table);
+        opts.scale = parser.get<double>("scale");
+        if (opts.scale <= 0.0 || opts.scale > 1.0) {
+                cerr << "INVALID_SCALE " << opts.scale << " (expected 0 < scale <= 1)" << endl;
+                return 1;
         }
-
-        framerec datFrame;
-        fdat.read_frame(datFrame);
-        deque<framerec> qDatFrames;
-        Mat vidFrame;
-
-        double scW = (capture.get(CAP_PROP_FRAME_WIDTH)) / ((double) IMAGE_WIDTH);
-        double scH = (capture.get(CAP_PROP_FRAME_HEIGHT)) / ((double) IMAGE_HEIGHT);
-
-        int queenId = 665;
-        double hil = 5.0; // Heading indicator length
-
-        if (parser.has("show")) {
-                namedWindow("Current frame", WINDOW_AUTOSIZE);
+        opts.opacity = parser.get<double>("overlayAlpha");
+        opts.sparse = parser.has("sparseOverlay") || opts.opacity < 1.0;
+        if (parser.has("followTag")) opts.followTag = parser.get<int>("followTag");
+        if (parser.has("focusTags") && !parse_tag_list(parser.get<String>("focusTags"), opts.focusTags)) return 1;
+        if (parser.has("heatmap")) {
+                opts.heatmapPrefix = parser.get<String>("heatmap");
+                opts.heatmapFormat = parser.get<String>("heatmapFormat");
+                if (opts.heatmapFormat != "png" && opts.heatmapFormat != "npy" && opts.heatmapFormat != "both") {
+                        cerr << "INVALID_HEATMAP_FORMAT " << opts.heatmapFormat << endl;
+                        return 1;
+                }
+                opts.heatmapBin = max(1, parser.get<int>("heatmapBin"));
+                if (parser.has("heatmapTags") && !parse_tag_list(parser.get<String>("heatmapTags"), opts.heatmapTags)) return 1;
+                for (size_t k = 0; k < opts.heatmapTags.size(); k++) {
+                        int idx;
+                        if (!find_idx(opts.heatmapTags[k], idx)) {
+                                cerr << "TAG_NOT_FOUND " << opts.heatmapTags[k] << endl;
+                                return 1;
+                        }
+                }
         }
-
-        cout << "start processing files" << endl;
-        int ct = 0;
-        do {
-                if (ct++ % 100 == 0) cout << " .";
-                if (ct % 1000 == 0) cout << endl;
-                capture >> vidFrame;
-                uint32_t frameNo = getVidFrame(vidFrame);
-                if (frameNo != datFrame.frame) {
-                        fdat.go_to_frame(frameNo);
-                        fdat.read_frame(datFrame);
+        opts.cropSize = max(16, parser.get<int>("cropSize"));
+        opts.stats = parser.has("stats");
+        if (parser.has("statsFile")) opts.statsFile = parser.get<String>("statsFile");
+
+        if (view) {
+                string error;
+                size_t cacheBytes = (size_t)max(0, parser.get<int>("viewCache")) * 1024 * 1024;
+                if (!run_viewer(jobs[0], shared, opts, cacheBytes, !parser.has("noCache"), error)) {
+                        cerr << error << endl;
+                        return 1;
                 }
-
-                qDatFrames.push_front(datFrame);
-                if (qDatFrames.size() > tl - 1) {
-                        qDatFrames.pop_back();
+                return 0;
+        }
+        if (!batch) {
+                string error;
+                if (!render_video(jobs[0], shared, opts, error)) {
+                        cerr << error << endl;
+                        return 1;
                 }
-                // string frameNumb = to_string(datFrame.frame);
-                string frameNumb = to_string(frameNo);
-                putText(vidFrame, frameNumb, Point(0, 50), FONT_HERSHEY_SCRIPT_SIMPLEX, 1.0, Scalar(0,0,255), 2, LINE_8, false);
-                for (int tagNo = 0; tagNo < tag_count; tagNo++) {
-                        if (datFrame.tags[tagNo].x >= 0) {
-                                // Draw the trajectory first
-                                double xHead = -1.0;
-                                double xTail = -1.0;
-                                double yHead = -1.0;
-                                double yTail = -1.0;
-                                for (int i = 0; i < tl; i++) {
-                                        if (i > qDatFrames.size() - 1) {
-                                                break;
-                                        }
-                                        if (qDatFrames.at(i).tags[tagNo].x >= 0) {
-                                                xTail = xHead;
-                                                yTail = yHead;
-                                                xHead = (double)qDatFrames.at(i).tags[tagNo].x * scH;
-                                                yHead = (double)qDatFrames.at(i).tags[tagNo].y * scW;
-                                                if (xTail > -1.0) {
-                                                        line(vidFrame, Point(xHead, yHead), Point(xTail, yTail), Scalar(255,255,0), 1, LINE_8);
-                                                }
-                                        }
-                                }
+                return 0;
+        }
 
-                                // Now draw everything else
-                                double x = (double)datFrame.tags[tagNo].x * scH;
-                                double y = (double)datFrame.tags[tagNo].y * scW;
-                                string idString = to_string(tag_list[tagNo]);
-                                if (tag_list[tagNo] == queenId) {
-                                        circle(vidFrame, Point(x, y), 2, Scalar(0,255,255), 2);
-                                } else {
-                                        if (datFrame.frame < frameOfDeath[tag_list[tagNo]]) {
-                                                circle(vidFrame, Point(x, y), 2, Scalar(0,0,255), 2);
-                                        } else {
-                                                circle(vidFrame, Point(x, y), 2, Scalar(255,0,255), 2);
-                                        }
-                                }
-                                putText(vidFrame, idString, Point(x + 4.0, y + 4.0), FONT_HERSHEY_SCRIPT_SIMPLEX, 0.4, Scalar(0,255,0), 1, LINE_8, false);
-                                line(vidFrame, Point(x, y), Point(x + hil * cos((double)datFrame.tags[tagNo].a * M_PI / 180.0 / 100.0), y + hil * sin((double)datFrame.tags[tagNo].a * M_PI / 180.0 / 100.0)), Scalar(255, 0, 0), 1, LINE_8);
-                        }
+        // Batch mode: several videos at once, the cores shared between them
+        int parallel = parser.get<int>("jobs");
+        if (parallel <= 0) {
+                parallel = max(1, cores / 4);
+        }
+        parallel = min(parallel, (int)jobs.size());
+        opts.threads = max(1, threads / max(1, parallel));
+        opts.show = false;
+        opts.progress = false;
+        int maxEncoders = parser.get<int>("maxEncoders");
+        Semaphore encoders(maxEncoders);
+        if (maxEncoders > 0) opts.encoders = &encoders;
+
+        cout << "rendering " << jobs.size() << " videos, " << parallel << " at once with " << opts.threads << " threads each" << endl;
+        vector <string> errors(jobs.size());
+        vector <char> failed(jobs.size(), 0);
+        run_work_stealing(parallel, jobs.size(), [&](size_t j, int) {
+                RenderOptions jobOpts = opts;
+                if (!opts.statsFile.empty()) {
+                        // one report per video
+                        jobOpts.statsFile = job_file_name(jobs[j].output, opts.statsFile);
                 }
-
-                if (interactions) {
-                        for (int i = 0; i < tag_count - 1; i++) {
-                                for (int j = i + 1; j < tag_count; j++) {
-                                        if (!i_table[i][j].empty()) {
-                                                vector<data>::iterator it = i_table[i][j].begin();
-                                                while(it != i_table[i][j].end()) {
-                                                        if (it->frame_start <= datFrame.frame && it->frame_stop >= datFrame.frame) {
-                                                                line(vidFrame, Point(it->x1 * scH, it->y1 * scW), Point(it->x2 * scH, it->y2 * scW), Scalar(0,215,255), 1, LINE_8);
-                                                        }
-                                                        it++;
-                                                }
-                                        }
-                                }
-                        }
+                if (!opts.heatmapPrefix.empty()) {
+                        jobOpts.heatmapPrefix = job_file_name(jobs[j].output, opts.heatmapPrefix);
                 }
-
-                outputVid << vidFrame;
-                if (parser.has("show")) {
-                        imshow("Current frame", vidFrame);
-                        waitKey(1000);
+                failed[j] = !render_video(jobs[j], shared, jobOpts, errors[j]);
+        });
+
+        int nFailed = 0;
+        for (size_t j = 0; j < jobs.size(); j++) {
+                if (failed[j]) {
+                        cerr << "JOB_FAILED " << jobs[j].video << ": " << errors[j] << endl;
+                        nFailed++;
                 }
-
-        } while (!vidFrame.empty() && fdat.read_frame(datFrame));
-
-        cout << endl << "Video written to: " << parser.get<String>("fVidOut") << endl;
-        return 0;
+        }
+        cout << jobs.size() - nFailed << " of " << jobs.size() << " videos rendered" << endl;
+        return nFailed > 0 ? 1 : 0;
 }
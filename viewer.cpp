@@ -0,0 +1,233 @@
+/*
+ * viewer.cpp
+ *
+ *  Interactive viewer, see viewer.hpp.
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+
+#include "anttrackingUNIL/datfile.h"
+
+#include "viewer.hpp"
+#include "datPrefetch.hpp"
+#include "frameIndex.hpp"
+#include "frameOcr.hpp"
+#include "frameSync.hpp"
+#include "stageStats.hpp"
+#include "trajectoryHistory.hpp"
+
+using namespace cv;
+using namespace std;
+
+/** class FrameCache
+ * \brief Least recently used overlaid frames, by position in the video
+ */
+class FrameCache {
+public:
+        explicit FrameCache(size_t capacity) : cap(max((size_t)1, capacity)) {}
+
+        bool get(int pos, Mat& frame) {
+                unordered_map <int, list <Entry>::iterator>::iterator it = index.find(pos);
+                if (it == index.end()) return false;
+                entries.splice(entries.begin(), entries, it->second);
+                frame = it->second->frame;
+                return true;
+        }
+
+        void put(int pos, const Mat& frame) {
+                if (index.count(pos)) return;
+                entries.push_front(Entry(pos, frame));
+                index[pos] = entries.begin();
+                if (entries.size() > cap) {
+                        index.erase(entries.back().pos);
+                        entries.pop_back();
+                }
+        }
+
+private:
+        struct Entry {
+                Entry(int p, const Mat& f) : pos(p), frame(f) {}
+                int pos;
+                Mat frame;
+        };
+
+        size_t cap;
+        list <Entry> entries;   // most recently used first
+        unordered_map <int, list <Entry>::iterator> index;
+};
+
+// Position asked for with the trackbar, -1 if none
+struct TrackbarState {
+        int current;
+        int requested;
+};
+
+static void on_trackbar(int pos, void* userdata) {
+        TrackbarState* s = (TrackbarState*)userdata;
+        // setTrackbarPos() during playback calls back with the current position
+        if (pos != s->current) s->requested = pos;
+}
+
+bool run_viewer(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, size_t cacheBytes, bool useCache, string& error) {
+        if (opts.rawIn) {
+                error = "The viewer needs a seekable video, not a raw stream";
+                return false;
+        }
+        vector <uint32_t> index;
+        if (!load_frame_index(job.video, index, useCache) || index.empty()) {
+                error = "Unable to index: " + job.video;
+                return false;
+        }
+        VideoCapture capture(job.video);
+        if (!capture.isOpened()) {
+                error = "Unable to open: " + job.video;
+                return false;
+        }
+        DatFile fdat;
+        if (!fdat.exists(job.dat)) {
+                error = "fdat file does not exist: " + job.dat;
+                return false;
+        }
+        fdat.open(job.dat, true);
+        DatPrefetcher prefetch(fdat);
+
+        const Size frameSize = scaled_size(Size((int)capture.get(CAP_PROP_FRAME_WIDTH), (int)capture.get(CAP_PROP_FRAME_HEIGHT)), opts.scale);
+        const int tl = max(2, opts.tl);
+        TrajectoryHistory history(tl);
+        InteractionTimeline timeline(shared.interactions);
+        OverlayContext ctx;
+        unique_ptr <LabelCache> scaledLabels;
+        init_overlay_context(ctx, shared, opts, frameSize, &history, scaledLabels);
+
+        const size_t frameBytes = (size_t)frameSize.width * frameSize.height * 3;
+        FrameCache cache(cacheBytes / max((size_t)1, frameBytes));
+
+        StageStats stats(false);
+        FrameSync sync(prefetch, stats, job.video);
+        int nextPos = 0;                // position of the next frame decoded without seeking
+        bool hasPrev = false;           // history ends with the dat frame of prevFrameNo
+        uint32_t prevFrameNo = 0;
+
+        // Decodes and overlays the frame at a position of the video
+        auto render_at = [&](int pos, Mat& out) {
+                Mat m;
+                if (pos != nextPos) capture.set(CAP_PROP_POS_FRAMES, pos);
+                nextPos = -1;
+                capture >> m;
+                const uint32_t frameNo = index[pos];
+                if (m.empty() || getVidFrame(m) != frameNo) {
+                        // inexact seek of the codec, correct it with the printed number
+                        uint32_t found;
+                        if (!seek_video(capture, index[0], frameNo, m, found) || found != frameNo) return false;
+                }
+                nextPos = pos + 1;
+
+                OverlayFrame f;
+                if (opts.scale != 1.0) {
+                        resize(m, f.vidFrame, frameSize, 0, 0, INTER_AREA);
+                } else {
+                        f.vidFrame = m;
+                }
+                f.frameNo = frameNo;
+
+                if (!hasPrev || frameNo != prevFrameNo + 1) {
+                        // jump: restart the trajectories with the frames leading to frameNo
+                        history.clear();
+                        uint32_t warm = min(frameNo, (uint32_t)(tl - 2));
+                        for (uint32_t i = 0; i < warm; i++) {
+                                const framerec* d = sync.at(frameNo - warm + i);
+                                if (d && d->frame == frameNo - warm + i) history.push(*d);
+                        }
+                }
+                const framerec* d = sync.at(frameNo);
+                if (!d || d->frame != frameNo) {
+                        // no tracking data for this frame, shown without overlay
+                        cerr << "NO_DAT_FRAME " << frameNo << endl;
+                        hasPrev = false;
+                        out = f.vidFrame;
+                        return true;
+                }
+                hasPrev = true;
+                prevFrameNo = frameNo;
+
+                f.histSeq = history.push(*d);
+                f.trailLen = (int)min(history.size(), (uint64_t)(tl - 1));
+                if (ctx.showInteractions) {
+                        timeline.seek(d->frame);
+                        f.activeInteractions = timeline.active();
+                }
+                draw_overlay(ctx, f);
+                out = f.vidFrame;
+                return true;
+        };
+
+        int pos = 0;
+        if (opts.hasStartFrame) {
+                vector <uint32_t>::const_iterator it = find(index.begin(), index.end(), opts.startFrame);
+                if (it != index.end()) pos = it - index.begin();
+        }
+        const int last = (int)index.size() - 1;
+        double fps = capture.get(CAP_PROP_FPS);
+        if (fps <= 0) fps = 25.0;
+        const double frameMs = 1000.0 / fps;
+
+        const string win = "trkVidOL " + job.video;
+        namedWindow(win, WINDOW_NORMAL);
+        TrackbarState tb;
+        tb.current = pos;
+        tb.requested = -1;
+        createTrackbar("frame", win, 0, last, on_trackbar, &tb);
+        setTrackbarPos("frame", win, pos);
+
+        bool playing = true;
+        int shown = -1;
+        for (;;) {
+                typedef chrono::steady_clock Clock;
+                Clock::time_point t0 = Clock::now();
+                if (pos != shown) {
+                        Mat frame;
+                        if (!cache.get(pos, frame)) {
+                                if (render_at(pos, frame)) {
+                                        cache.put(pos, frame);
+                                } else {
+                                        // not cached, the position is decoded again when revisited
+                                        cerr << "CANNOT_READ_FRAME " << index[pos] << endl;
+                                        playing = false;
+                                        frame = Mat::zeros(frameSize, CV_8UC3);
+                                }
+                        }
+                        imshow(win, frame);
+                        tb.current = pos;
+                        setTrackbarPos("frame", win, pos);
+                        shown = pos;
+                }
+
+                // pace playback on the frame rate, poll the keyboard while paused
+                int wait = 30;
+                if (playing) {
+                        double spent = chrono::duration<double, milli>(Clock::now() - t0).count();
+                        wait = max(1, (int)(frameMs - spent));
+                }
+                int key = waitKey(wait);
+                if (key == 'q' || key == 27 || getWindowProperty(win, WND_PROP_VISIBLE) < 1) break;
+                if (key == ' ') playing = !playing;
+                if (key == 'd' || key == '.' || key == 'a' || key == ',') {
+                        playing = false;
+                        pos = max(0, min(last, pos + ((key == 'd' || key == '.') ? 1 : -1)));
+                }
+                if (tb.requested >= 0) {
+                        pos = tb.requested;
+                        tb.requested = -1;
+                } else if (playing) {
+                        if (pos < last) pos++;
+                        else playing = false;
+                }
+        }
+        destroyWindow(win);
+        return true;
+}
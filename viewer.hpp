@@ -0,0 +1,27 @@
+/*
+ * viewer.hpp
+ *
+ *  Interactive review of a tracking video with its overlay (--view).
+ *
+ */
+
+#ifndef VIEWER_HPP
+#define VIEWER_HPP
+
+#include <string>
+
+#include "render.hpp"
+
+/** bool run_viewer(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, size_t cacheBytes, bool useCache, std::string& error)
+ * \brief Shows job.video with its overlay in a window with a frame trackbar.
+ *        Playback is paced to the frame rate of the video. Keys: space
+ *        play / pause, a or , previous frame, d or . next frame, q or Esc
+ *        quit. Nothing is written except the frame index sidecar of the video.
+ * \param cacheBytes Memory for the overlaid frames kept for going back
+ * \param useCache Read and write the frame index sidecar
+ * \param error Set to the reason of a failure
+ * \return false if the video or dat file cannot be opened
+ */
+bool run_viewer(const RenderJob& job, const SharedData& shared, const RenderOptions& opts, size_t cacheBytes, bool useCache, std::string& error);
+
+#endif // VIEWER_HPP